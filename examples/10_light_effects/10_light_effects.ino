@@ -0,0 +1,83 @@
+/**
+ * This example plays effects described by keyframe timelines stored in flash (see
+ * light_effect.h) on 8 lights, switching effect every 20 seconds. Between the keyframes the
+ * lights fade by themselves at each semi-period, so loop() is free to do anything else, as long
+ * as it calls update() from time to time.
+ *
+ * NOTE: the timing of the effects is not affected by a slow loop(), but each keyframe is
+ *       reached no earlier than the update() following it.
+ */
+#include <dimmable_light.h>
+#include <light_effect.h>
+
+const int syncPin = 13;
+
+#if defined(ESP8266)
+DimmableLight lights[] = { { 5 }, { 4 }, { 14 }, { 12 }, { 15 }, { 16 }, { 0 }, { 2 } };
+#elif defined(ESP32)
+DimmableLight lights[] = { { 4 }, { 16 }, { 17 }, { 5 }, { 18 }, { 19 }, { 21 }, { 22 } };
+#else
+DimmableLight lights[] = { { 3 }, { 4 }, { 5 }, { 6 }, { 7 }, { 8 }, { 9 }, { 10 } };
+#endif
+
+const uint8_t nLights = sizeof(lights) / sizeof(lights[0]);
+
+// All the lights fade in and out together: a single channel
+const uint8_t breathe[] PROGMEM = {
+  1, 2,
+  LIGHT_EFFECT_TIME(3000), 0,
+  LIGHT_EFFECT_TIME(3000), 200,
+};
+
+// Even and odd lights fade in opposite directions
+const uint8_t seesaw[] PROGMEM = {
+  2, 2,
+  LIGHT_EFFECT_TIME(1500), 0, 200,
+  LIGHT_EFFECT_TIME(1500), 200, 0,
+};
+
+// A bright spot running around the lights, with dimmed neighbors
+const uint8_t circularSwipe[] PROGMEM = {
+  8, 8,
+  LIGHT_EFFECT_TIME(400), 200, 60, 0, 0, 0, 0, 0, 60,
+  LIGHT_EFFECT_TIME(400), 60, 200, 60, 0, 0, 0, 0, 0,
+  LIGHT_EFFECT_TIME(400), 0, 60, 200, 60, 0, 0, 0, 0,
+  LIGHT_EFFECT_TIME(400), 0, 0, 60, 200, 60, 0, 0, 0,
+  LIGHT_EFFECT_TIME(400), 0, 0, 0, 60, 200, 60, 0, 0,
+  LIGHT_EFFECT_TIME(400), 0, 0, 0, 0, 60, 200, 60, 0,
+  LIGHT_EFFECT_TIME(400), 0, 0, 0, 0, 0, 60, 200, 60,
+  LIGHT_EFFECT_TIME(400), 60, 0, 0, 0, 0, 0, 60, 200,
+};
+
+const uint8_t* const effects[] = { breathe, seesaw, circularSwipe };
+const uint8_t nEffects = sizeof(effects) / sizeof(effects[0]);
+
+LightEffect<DimmableLight> player(lights, nLights);
+
+uint8_t effectSelected = 0;
+uint32_t lastSwitch = 0;
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial)
+    ;
+  Serial.println();
+  Serial.println("Dimmable Light for Arduino: effects from keyframe timelines");
+
+  DimmableLight::setSyncPin(syncPin);
+  DimmableLight::begin();
+
+  player.play(effects[effectSelected]);
+  lastSwitch = millis();
+}
+
+void loop() {
+  player.update();
+
+  if (millis() - lastSwitch > 20000) {
+    effectSelected = (effectSelected + 1) % nEffects;
+    Serial.println(String("Effect: ") + effectSelected);
+    player.play(effects[effectSelected]);
+    lastSwitch = millis();
+  }
+}
@@ -26,6 +26,9 @@ const int pins[N] = { 3, 4, 5 };
 
 DimmableLightManager dlm;
 
+// A scene sets many lights at once, they are referenced by handle to avoid the name lookups
+DimmableLightManager::Scene halfScene;
+
 void setup() {
   Serial.begin(115200);
   while (!Serial)
@@ -47,15 +50,20 @@ void setup() {
   DimmableLight::setSyncPin(syncPin);
   DimmableLightManager::begin();
 
+  // Resolve the names once
+  for (int i = 0; i < N; i++) {
+    halfScene.set(dlm.resolve(String("light") + (i + 1)), 127);
+  }
+
   Serial.println("Done!");
 }
 
 void loop() {
   for (int b = 0; b < 255; b += 10) {
     for (int i = 0; i < dlm.getCount(); i++) {
-      std::pair<String, DimmableLight*> p = dlm.get();
-      String lightName = p.first;
-      DimmableLight* dimLight = p.second;
+      DimmableLightManager::Entry e = dlm.get();
+      const char* lightName = e.name;
+      DimmableLight* dimLight = e.light;
       // Altervatively, you can require to the manager a specific light
       // DimmableLight* dimLight = dlm.get("light1");
 
@@ -65,4 +73,9 @@ void loop() {
     delay(500);
   }
   Serial.println();
+
+  // All the lights to half brightness, fading in 1 second
+  Serial.println("Applying the scene");
+  dlm.apply(halfScene, 1000);
+  delay(2000);
 }
@@ -30,7 +30,7 @@ void doRaise(void) {
   static uint8_t brightnessStep = 0;
 
   for (int i = 0; i < dlm.getCount(); i++) {
-    DimmableLight* dimLight = dlm.get().second;
+    DimmableLight* dimLight = dlm.get().light;
     dimLight->setBrightness(brightnessStep);
   }
 
@@ -46,7 +46,7 @@ void doLower(void) {
   static uint8_t brightnessStep = 255;
 
   for (int i = 0; i < dlm.getCount(); i++) {
-    DimmableLight* dimLight = dlm.get().second;
+    DimmableLight* dimLight = dlm.get().light;
     dimLight->setBrightness(brightnessStep);
   }
 
@@ -88,13 +88,12 @@ void setup() {
 
 void loop() {
   // Print the light name and its actual brightness
-  for (int i = 0; i < dlm.getCount(); i++) {
-    std::pair<String, DimmableLight*> p = dlm.get();
-    DimmableLight* dimLight = p.second;
+  for (DimmableLightManager::Entry e : dlm.lights()) {
+    DimmableLight* dimLight = e.light;
     // Altervatively, you can require to the manager a specific light
     // DimmableLight* dimLight = dlm.get("light1");
 
-    Serial.println(String(p.first) + " brightness:" + dimLight->getBrightness());
+    Serial.println(String(e.name) + " brightness:" + dimLight->getBrightness());
   }
   Serial.println();
 
@@ -158,6 +158,11 @@ void loop() {
   if (effectSelected == -1) {
     delay(20);
   } else if (now - lastCall > period) {
-    if (effect != nullptr) effect();
+    if (effect != nullptr) {
+      // Apply all the brightness changes of this step at once
+      lights[0].beginUpdate();
+      effect();
+      lights[0].commitUpdate();
+    }
   }
 }
@@ -10,6 +10,8 @@ const int syncPin = 13;
 const int thyristorPin = 14;
 
 DimmableLightLinearized light(thyristorPin);
+// For other loads, give the curve, e.g. for a heater:
+// DimmableLightLinearized light(thyristorPin, 0, PowerCurve::resistive);
 
 // Delay between a brightness changement in millisecond
 const int period = 50;
@@ -6,8 +6,10 @@
  * the actual frequency and then set the correct frequency. Since the
  * detected value may be imprecise due to noise, it is up to you
  * to implement the logic to chose the proper frequency. The frequency
- * is calculated with a moving average (by default on the last 5 values)
- * and it is continuosly updated.
+ * is estimated by tracking the zero crosses and it is continuosly updated.
+ *
+ * NOTE: without calling setFrequency(), the semi-period follows the
+ *       detected frequency by itself.
  *
  * NOTE: you have to select NETWORK_FREQ_RUNTIME and MONITOR_FREQUENCY
  *       #defines in thyristor.h
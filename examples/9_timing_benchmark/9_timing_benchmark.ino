@@ -0,0 +1,110 @@
+/**
+ * This example measures, on the target MCU, how long the main thread spends to apply new delays,
+ * either one setDelay(..) at a time or through a batch update, for an increasing number of
+ * dimmed channels and for different delay sets:
+ * - random: delays uniformly distributed in the controllable range;
+ * - equal: all the channels share the same delay (a single activation per semi-period);
+ * - spread: each delay is 25us after the previous one, just outside the default merge period on
+ *   most MCUs (the highest number of interrupts per semi-period);
+ * - reverse: delays sorted in the opposite order w.r.t. the current ones (the worst reordering).
+ *
+ * Results are printed on the serial port as a table, in microseconds per update. The sync signal
+ * is not required: the ISR-side timing can be checked by probing the gate pins with a scope, or
+ * simulated on the host for up to 32 channels (see extras/host_sim).
+ */
+#include <thyristor.h>
+
+const int syncPin = 13;
+
+#if defined(ESP8266)
+Thyristor thyristors[] = { { 5 }, { 4 }, { 14 }, { 12 }, { 15 }, { 16 }, { 0 }, { 2 } };
+#elif defined(ESP32)
+Thyristor thyristors[] = { { 4 }, { 16 }, { 17 }, { 5 }, { 18 }, { 19 }, { 21 }, { 22 } };
+#else
+Thyristor thyristors[] = { { 3 }, { 4 }, { 5 }, { 6 }, { 7 }, { 8 }, { 9 }, { 10 } };
+#endif
+
+const uint8_t nChannels = sizeof(thyristors) / sizeof(thyristors[0]);
+
+// Number of updates averaged for each measurement
+const int repetitions = 50;
+
+enum DelaySet { RANDOM, EQUAL, SPREAD, REVERSE };
+const char* delaySetNames[] = { "random", "equal", "spread", "reverse" };
+
+/**
+ * Fill *delays* with the given set for *n* channels. *variant* alternates between 2 different
+ * sets of the same kind, so every update really changes the delays.
+ */
+void fillDelays(DelaySet set, uint8_t n, uint8_t variant, uint16_t* delays) {
+  const uint16_t semiPeriod = Thyristor::getSemiPeriod();
+  for (uint8_t i = 0; i < n; i++) {
+    switch (set) {
+      case RANDOM: delays[i] = random(1000, semiPeriod - 1000); break;
+      case EQUAL: delays[i] = 3000 + variant * 2000; break;
+      case SPREAD: delays[i] = 2000 + variant * 10 + i * 25; break;
+      case REVERSE: delays[i] = variant ? 2000 + i * 500 : 2000 + (n - 1 - i) * 500; break;
+    }
+  }
+}
+
+/**
+ * Return the average time of a setDelay(..) call.
+ */
+float measureSetDelay(DelaySet set, uint8_t n) {
+  uint16_t delays[nChannels];
+  uint32_t elapsed = 0;
+  for (int r = 0; r < repetitions; r++) {
+    fillDelays(set, n, r % 2, delays);
+    uint32_t start = micros();
+    for (uint8_t i = 0; i < n; i++) { thyristors[i].setDelay(delays[i]); }
+    elapsed += micros() - start;
+  }
+  return (float)elapsed / repetitions / n;
+}
+
+/**
+ * Return the average time to apply all the delays through a batch update.
+ */
+float measureBatch(DelaySet set, uint8_t n) {
+  uint16_t delays[nChannels];
+  uint32_t elapsed = 0;
+  for (int r = 0; r < repetitions; r++) {
+    fillDelays(set, n, r % 2, delays);
+    uint32_t start = micros();
+    Thyristor::beginUpdate();
+    for (uint8_t i = 0; i < n; i++) { thyristors[i].setDelay(delays[i]); }
+    Thyristor::commitUpdate();
+    elapsed += micros() - start;
+  }
+  return (float)elapsed / repetitions;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial)
+    ;
+  Serial.println();
+  Serial.println("Dimmable Light for Arduino: timing benchmark");
+  Serial.println();
+
+  Thyristor::setSyncPin(syncPin);
+  Thyristor::begin();
+
+  Serial.println("channels\tset\tsetDelay [us]\tbatch [us]");
+  for (uint8_t n = 1; n <= nChannels; n++) {
+    for (uint8_t set = RANDOM; set <= REVERSE; set++) {
+      // Only the first n channels are dimmed, the others are fully off
+      for (uint8_t i = 0; i < nChannels; i++) {
+        thyristors[i].setDelay(Thyristor::getSemiPeriod());
+      }
+
+      float single = measureSetDelay((DelaySet)set, n);
+      float batch = measureBatch((DelaySet)set, n);
+      Serial.println(String(n) + "\t" + delaySetNames[set] + "\t" + single + "\t" + batch);
+    }
+  }
+  Serial.println("Done!");
+}
+
+void loop() {}
@@ -0,0 +1,406 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+/***********************************************************************************
+ * Host simulation of the ISRs: thyristor.cpp is built for RP2040 against the stubs
+ * in stubs/, while this harness plays the hardware. The zero cross interrupt is
+ * raised every semi-period (50Hz), the alarms armed through the timer HAL are
+ * delivered *alarmLatency* microseconds late, and the gate pins are sampled on each
+ * write. For 1 to 32 channels (up to THYRISTOR_MAX_NUMBER) and a few delay sets, it reports:
+ * - the interrupts (zero cross and timer) per semi-period;
+ * - the time spent in the ISRs, measured on the host CPU;
+ * - the error of the gate rising edges w.r.t. the requested delays (merged and nudged
+ *   activations included) and, with THYRISTOR_STATS, w.r.t. the scheduled ones;
+ * - the time spent by the main thread in a setDelay(..), and in a batch update of all the
+ *   channels up to commitUpdate().
+ * The zero cross ISR time is also reported while all the channels fade across each other.
+ * It fails if a gate misses its edge, stays on across the zero cross, or if any edge is off
+ * the requested delay by more than the latency and the merge window, or off the scheduled one
+ * by anything but the latency. With NETWORK_FREQ_RUNTIME and THYRISTOR_COMMAND_QUEUE,
+ * it also checks that the lights set or posted on and off before the frequency is known keep
+ * so once it is set.
+ ***********************************************************************************/
+#include <Arduino.h>
+#include <hardware/gpio.h>
+#include <chrono>
+#include "hw_timer_pico.h"
+#include "thyristor.h"
+#if defined(NETWORK_FREQ_RUNTIME) && defined(THYRISTOR_COMMAND_QUEUE)
+#include "dimmable_light_linearized.h"
+#endif
+
+// Simulated hardware
+static const uint16_t semiPeriod = 10000;
+static const uint16_t alarmLatency = 3;
+static const uint8_t syncPin = 40;
+
+// The merge window of the ISR cost model in thyristor.cpp, for RP2040 unless given in the build
+// flags: a scheduled activation is off the requested one by less than that
+#if defined(THYRISTOR_ISR_ENTRY_COST) && defined(THYRISTOR_ISR_THYRISTOR_COST)
+static const uint16_t modelCost =
+  THYRISTOR_ISR_ENTRY_COST + Thyristor::N * THYRISTOR_ISR_THYRISTOR_COST;
+#else
+static const uint16_t modelCost = 10 + Thyristor::N * 1;
+#endif
+static const uint16_t mergeBound = modelCost > 20 ? modelCost : 20;
+
+static uint32_t now = 0;
+static void (*zeroCrossIsr)() = nullptr;
+static void (*alarmIsr)() = nullptr;
+static bool alarmArmed = false;
+static uint32_t alarmAt = 0;
+
+static uint32_t gateState = 0;
+static uint32_t risingAt[32];
+static uint8_t risingCount[32];
+
+Print Serial;
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalPinToInterrupt(int pin) {
+  return pin;
+}
+void attachInterrupt(int, void (*isr)(), int) {
+  zeroCrossIsr = isr;
+}
+void detachInterrupt(int) {
+  zeroCrossIsr = nullptr;
+}
+uint32_t micros() {
+  return now;
+}
+uint32_t millis() {
+  return now / 1000;
+}
+void delayMicroseconds(unsigned int) {}
+void noInterrupts() {}
+void interrupts() {}
+
+void gpio_set_mask(uint32_t mask) {
+  for (uint8_t pin = 0; pin < 32; pin++) {
+    if ((mask >> pin & 1) && !(gateState >> pin & 1)) {
+      risingAt[pin] = now;
+      risingCount[pin]++;
+    }
+  }
+  gateState |= mask;
+}
+
+void gpio_clr_mask(uint32_t mask) {
+  gateState &= ~mask;
+}
+
+// As the RP2040 HAL, the alarm is relative to the origin and it replaces the armed one
+static uint32_t alarmOrigin = 0;
+void timerBegin(bool) {}
+void timerSetCallback(void (*callback)()) {
+  alarmIsr = callback;
+}
+void timerRestart() {
+  alarmOrigin = now;
+}
+void timerShift(int32_t shift) {
+  alarmOrigin -= shift;
+}
+void timerStart(uint32_t t) {
+  alarmArmed = true;
+  alarmAt = alarmOrigin + t;
+}
+void timerStop() {
+  alarmArmed = false;
+}
+
+/**
+ * Measurements of a simulated run.
+ */
+struct Run {
+  uint8_t channels;
+  uint16_t delays[32];
+  uint32_t semiPeriods;
+  uint32_t interrupts;
+  uint32_t alarms;
+  uint64_t isrNanoseconds;
+  uint64_t isrNanosecondsMax;
+  uint64_t zeroCrossNanoseconds;
+  uint64_t zeroCrossNanosecondsMax;
+  uint32_t edges;
+  int64_t errorSum;
+  uint32_t errorMax;
+  int32_t errorMin;
+  int32_t errorHigh;
+  int32_t scheduleErrorMin;
+  int32_t scheduleErrorMax;
+  uint32_t missedEdges;
+  uint32_t stuckGates;
+  uint64_t setNanoseconds;
+  uint64_t commitNanoseconds;
+};
+
+static uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                               - start)
+    .count();
+}
+
+static uint64_t runIsr(void (*isr)(), Run &run) {
+  auto start = std::chrono::steady_clock::now();
+  isr();
+  uint64_t elapsed = nanosecondsSince(start);
+  run.interrupts++;
+  run.isrNanoseconds += elapsed;
+  if (elapsed > run.isrNanosecondsMax) { run.isrNanosecondsMax = elapsed; }
+  return elapsed;
+}
+
+/**
+ * Simulate one semi-period, from its zero cross to the next one. If *thyristors* is not null, the
+ * gate edges are checked against the delays of the run.
+ */
+static void runSemiPeriod(Run &run, Thyristor **thyristors) {
+  const uint32_t zeroCross = now;
+  const uint32_t channelMask = run.channels < 32 ? (1ul << run.channels) - 1 : UINT32_MAX;
+  if (thyristors && (gateState & channelMask)) { run.stuckGates++; }
+
+  memset(risingCount, 0, sizeof(risingCount));
+  if (zeroCrossIsr) {
+    uint64_t elapsed = runIsr(zeroCrossIsr, run);
+    run.zeroCrossNanoseconds += elapsed;
+    if (elapsed > run.zeroCrossNanosecondsMax) { run.zeroCrossNanosecondsMax = elapsed; }
+  }
+  while (alarmArmed && alarmAt - zeroCross < semiPeriod) {
+    alarmArmed = false;
+    // An alarm already past triggers at once
+    now = ((int32_t)(alarmAt - now) > 0 ? alarmAt : now) + alarmLatency;
+    run.alarms++;
+    if (alarmIsr) { runIsr(alarmIsr, run); }
+  }
+  now = zeroCross + semiPeriod;
+  if (!thyristors) { return; }
+
+  run.semiPeriods++;
+  for (uint8_t i = 0; i < run.channels; i++) {
+    if (risingCount[i] != 1) {
+      run.missedEdges++;
+      continue;
+    }
+    int32_t error = (int32_t)(risingAt[i] - zeroCross) - run.delays[i];
+    uint32_t absError = error < 0 ? -error : error;
+    run.edges++;
+    run.errorSum += absError;
+    if (absError > run.errorMax) { run.errorMax = absError; }
+    if (error < run.errorMin) { run.errorMin = error; }
+    if (error > run.errorHigh) { run.errorHigh = error; }
+#ifdef THYRISTOR_STATS
+    int32_t scheduleError = error - thyristors[i]->getDelayError();
+    if (scheduleError < run.scheduleErrorMin) { run.scheduleErrorMin = scheduleError; }
+    if (scheduleError > run.scheduleErrorMax) { run.scheduleErrorMax = scheduleError; }
+#endif
+  }
+}
+
+enum Pattern { EQUAL, SPREAD, RANDOM };
+static const char *const patternNames[] = { "equal", "spread", "random" };
+
+static uint16_t patternDelay(Pattern pattern, uint8_t i, uint32_t &seed) {
+  switch (pattern) {
+    case EQUAL: return 5000;
+    case SPREAD: return 1000 + 25 * i;
+    default:
+      // Inside the controllable range, away from the margins
+      seed = seed * 1103515245 + 12345;
+      return 300 + (seed >> 16) % 9100;
+  }
+}
+
+/**
+ * Drive *channels* thyristors with the delays of *pattern*, print the measurements and return
+ * true if all the gates were fired as scheduled.
+ */
+static bool simulate(Pattern pattern, uint8_t channels) {
+  static uint32_t seed = 1;
+  Run run = {};
+  run.channels = channels;
+  run.errorMin = INT32_MAX;
+  run.errorHigh = INT32_MIN;
+  run.scheduleErrorMin = INT32_MAX;
+  run.scheduleErrorMax = INT32_MIN;
+
+  Thyristor *thyristors[32];
+  for (uint8_t i = 0; i < channels; i++) { thyristors[i] = new Thyristor(i); }
+  auto start = std::chrono::steady_clock::now();
+  Thyristor::beginUpdate();
+  for (uint8_t i = 0; i < channels; i++) {
+    run.delays[i] = patternDelay(pattern, i, seed);
+    thyristors[i]->setDelay(run.delays[i]);
+  }
+  Thyristor::commitUpdate();
+  run.commitNanoseconds = nanosecondsSince(start);
+
+  // The new schedule is switched to at the next zero cross
+  Run warmUp = run;
+  for (int i = 0; i < 2; i++) { runSemiPeriod(warmUp, nullptr); }
+#ifdef THYRISTOR_STATS
+  Thyristor::resetStats();
+#endif
+  for (int i = 0; i < 100; i++) { runSemiPeriod(run, thyristors); }
+  bool ok = run.missedEdges == 0 && run.stuckGates == 0
+            && run.errorMin >= alarmLatency - mergeBound
+            && run.errorHigh <= alarmLatency + mergeBound;
+#ifdef THYRISTOR_STATS
+  Thyristor::Stats stats = Thyristor::getStats();
+  // The alarms are armed from the zero cross: every edge is late by the latency alone
+  ok &= stats.lateSemiPeriods == 0 && run.scheduleErrorMin == alarmLatency
+        && run.scheduleErrorMax == alarmLatency;
+#endif
+
+  // One delay at a time, each one compiles the whole schedule
+  start = std::chrono::steady_clock::now();
+  for (uint8_t i = 0; i < channels; i++) { thyristors[i]->setDelay(run.delays[i] + 100); }
+  run.setNanoseconds = nanosecondsSince(start) / channels;
+
+  for (uint8_t i = 0; i < channels; i++) { delete thyristors[i]; }
+  for (int i = 0; i < 2; i++) { runSemiPeriod(warmUp, nullptr); }
+
+  printf("%-7s %3u %9.2f %10.2f %8.0f %7llu %8.1f %4d..%-4d", patternNames[pattern], channels,
+         (double)run.interrupts / run.semiPeriods, (double)run.alarms / run.semiPeriods,
+         (double)run.isrNanoseconds / run.semiPeriods, (unsigned long long)run.isrNanosecondsMax,
+         run.edges ? (double)run.errorSum / run.edges : 0.0, run.errorMin, run.errorHigh);
+#ifdef THYRISTOR_STATS
+  printf(" %4d..%-4d", run.scheduleErrorMin, run.scheduleErrorMax);
+#else
+  printf("       -  ");
+#endif
+  printf(" %7llu %9llu  %s\n", (unsigned long long)run.setNanoseconds,
+         (unsigned long long)run.commitNanoseconds, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+/**
+ * Fade *channels* thyristors in opposite directions, so that each step reorders them, print the
+ * zero cross ISR time along the fade and return true if the gates were released at each zero
+ * cross and the fades ended in time.
+ */
+static bool simulateFades(uint8_t channels) {
+  const uint32_t channelMask = channels < 32 ? (1ul << channels) - 1 : UINT32_MAX;
+  Run run = {};
+  run.channels = channels;
+
+  Thyristor *thyristors[32];
+  for (uint8_t i = 0; i < channels; i++) {
+    thyristors[i] = new Thyristor(i);
+    thyristors[i]->setDelay(1000 + 8000 * i / channels);
+  }
+  for (int i = 0; i < 2; i++) { runSemiPeriod(run, nullptr); }
+
+  // 1s at 50Hz, 100 steps
+#ifdef THYRISTOR_STATS
+  Thyristor::resetStats();
+#endif
+  for (uint8_t i = 0; i < channels; i++) {
+    thyristors[i]->setDelay(9000 - 8000 * i / channels, 1000);
+  }
+  Run fade = run;
+  for (int i = 0; i < 102; i++) {
+    if (gateState & channelMask) { fade.stuckGates++; }
+    runSemiPeriod(fade, nullptr);
+    fade.semiPeriods++;
+  }
+  bool ok = fade.stuckGates == 0;
+#ifdef THYRISTOR_STATS
+  ok &= Thyristor::getStats().lateSemiPeriods == 0;
+#endif
+  for (uint8_t i = 0; i < channels; i++) { ok &= !thyristors[i]->isFading(); }
+
+  for (uint8_t i = 0; i < channels; i++) { delete thyristors[i]; }
+  for (int i = 0; i < 2; i++) { runSemiPeriod(run, nullptr); }
+
+  printf("fade    %3u %11.0f %10llu  %s\n", channels,
+         (double)fade.zeroCrossNanoseconds / fade.semiPeriods,
+         (unsigned long long)fade.zeroCrossNanosecondsMax, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+#if defined(NETWORK_FREQ_RUNTIME) && defined(THYRISTOR_COMMAND_QUEUE)
+/**
+ * Turn 4 lights on and off through setBrightness(..) and postBrightness(..) while the frequency
+ * is unknown, set it to 50Hz and return true if the lights are kept on and off.
+ */
+static bool simulateUnknownFrequency() {
+  const uint8_t maxBri = DimmableLightLinearized::MAX_BRIGHTNESS;
+  DimmableLightLinearized setOff(0), postOff(1), setOn(2), postOn(3);
+  setOff.setBrightness(0);
+  postOff.postBrightness(0);
+  setOn.setBrightness(maxBri);
+  postOn.postBrightness(maxBri);
+  Run run = {};
+  run.channels = 4;
+  for (int i = 0; i < 2; i++) { runSemiPeriod(run, nullptr); }
+  Thyristor::setFrequency(1000000 / 2 / semiPeriod);
+
+  // Gates seen high in each semi-period, after the switch to the new schedule
+  bool ok = true;
+  for (int i = 0; i < 6; i++) {
+    uint32_t high = gateState;
+    runSemiPeriod(run, nullptr);
+    for (uint8_t pin = 0; pin < 4; pin++) {
+      if (risingCount[pin]) { high |= 1ul << pin; }
+    }
+    if (i >= 2 && (high & 0xf) != 0xc) { ok = false; }
+  }
+  printf("on and off before the frequency is known: %s\n\n", ok ? "ok" : "FAIL");
+
+  setOn.setBrightness(0);
+  postOn.postBrightness(0);
+  for (int i = 0; i < 2; i++) { runSemiPeriod(run, nullptr); }
+  return ok;
+}
+#endif
+
+int main() {
+  Thyristor::setSyncPin(syncPin);
+  Thyristor::begin();
+  bool ok = true;
+#ifdef NETWORK_FREQ_RUNTIME
+#ifdef THYRISTOR_COMMAND_QUEUE
+  ok = simulateUnknownFrequency();
+#endif
+  Thyristor::setFrequency(1000000 / 2 / semiPeriod);
+#endif
+
+  printf("%d channels at most, alarm latency %uus, merge window %uus, 50Hz\n", Thyristor::N,
+         alarmLatency, mergeBound);
+  printf("ISR and main thread host times in ns, gate edge errors in us\n\n");
+  printf("pattern  ch  irq/half alarm/half  ns/half isr max  err avg    req err  sched err"
+         "  set ns commit ns\n");
+
+  static const uint8_t channelCounts[] = { 1, 2, 4, 8, 16, 32 };
+  for (int p = EQUAL; p <= RANDOM; p++) {
+    for (uint8_t channels : channelCounts) {
+      if (channels <= Thyristor::N) { ok &= simulate((Pattern)p, channels); }
+    }
+  }
+
+  printf("\npattern  ch  zc ns/half  zc ns max\n");
+  for (uint8_t channels : channelCounts) {
+    if (channels <= Thyristor::N) { ok &= simulateFades(channels); }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+/***********************************************************************************
+ * Minimal Arduino API for the host simulation (see isr_sim.cpp): just what the
+ * library needs, with the pins, the interrupts and the clock simulated by the harness.
+ ***********************************************************************************/
+#ifndef HOST_SIM_ARDUINO_H
+#define HOST_SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define PROGMEM
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+#define ARDUINO_ISR_ATTR
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(int interrupt, void (*isr)(), int mode);
+void detachInterrupt(int interrupt);
+uint32_t micros();
+uint32_t millis();
+void delayMicroseconds(unsigned int us);
+void noInterrupts();
+void interrupts();
+
+class Print {
+public:
+  void print(const __FlashStringHelper *s) { printf("%s", reinterpret_cast<const char *>(s)); }
+  void print(const char *s) { printf("%s", s); }
+  void print(long n) { printf("%ld", n); }
+  void print(int n) { printf("%d", n); }
+  void print(unsigned int n) { printf("%u", n); }
+  void print(unsigned long n) { printf("%lu", n); }
+  template<class T> void println(T value) {
+    print(value);
+    println();
+  }
+  void println() { printf("\n"); }
+};
+
+extern Print Serial;
+
+#endif  // HOST_SIM_ARDUINO_H
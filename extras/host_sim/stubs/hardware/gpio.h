@@ -0,0 +1,30 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+// Host simulation: the SIO set/clear registers are simulated by the harness
+#ifndef HOST_SIM_HARDWARE_GPIO_H
+#define HOST_SIM_HARDWARE_GPIO_H
+
+#include <stdint.h>
+
+void gpio_set_mask(uint32_t mask);
+void gpio_clr_mask(uint32_t mask);
+
+#endif  // HOST_SIM_HARDWARE_GPIO_H
@@ -2,7 +2,7 @@
  *  This file is part of Dimmable Light for Arduino, a library to control     *
  *  dimmers.                                                                  *
  *                                                                            *
- *  Copyright (C) 2018-2023  Fabiano Riccardi                                 *
+ *  Copyright (C) 2025  Bart Celary                                           *
  *                                                                            *
  *  Dimmable Light for Arduino is free software; you can redistribute         *
  *  it and/or modify it under the terms of the GNU Lesser General Public      *
@@ -17,58 +17,25 @@
  *  You should have received a copy of the GNU Lesser General Public License  *
  *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
  ******************************************************************************/
-#ifndef CIRCULAR_QUEUE_H
-#define CIRCULAR_QUEUE_H
 
-/*
- * A minimal static circular queue.
- * It supports only insertion, and older values are automatically overwritten.
- */
-template<typename T, int N> class CircularQueue {
-public:
-  /**
-   * Construct a new Circular Queue object filling it with zeros or
-   * using the default constructor of type T.
-   */
-  CircularQueue() : arr{ 0 }, index(0), n(0){};
+// Host simulation: the harness runs on a single thread, so the critical sections are no-ops
+#ifndef HOST_SIM_PICO_CRITICAL_SECTION_H
+#define HOST_SIM_PICO_CRITICAL_SECTION_H
 
-  /**
-   * Insert an element. If full, it returns the overwritten element.
-   */
-  T insert(T value) {
-    T ret = arr[index];
-    arr[index] = value;
-    index++;
-    if (index == N) { index = 0; }
-    if (n < N) { n++; }
+typedef struct {
+  bool initialized;
+} critical_section_t;
 
-    return ret;
-  };
+static inline void critical_section_init(critical_section_t *cs) {
+  cs->initialized = true;
+}
 
-  /**
-   * Empty the queue.
-   */
-  void reset() {
-    for (int i = 0; i < N; i++) { arr[i] = 0; }
-    n = 0;
-    index = 0;
-  }
+static inline bool critical_section_is_initialized(critical_section_t *cs) {
+  return cs->initialized;
+}
 
-  /**
-   * Return the number of stored elements.
-   */
-  int getCount() const {
-    return n;
-  };
+static inline void critical_section_enter_blocking(critical_section_t *) {}
 
-private:
-  T arr[N];
+static inline void critical_section_exit(critical_section_t *) {}
 
-  // The position for the next element to be inserted
-  int index;
-
-  // Number of elements currently stored
-  int n;
-};
-
-#endif  // END CIRCULAR_QUEUE_H
+#endif  // HOST_SIM_PICO_CRITICAL_SECTION_H
@@ -50,10 +50,10 @@ public:
    * Maps to hardware range minBrightness-HW_MAX
    * Input 0 always maps to hardware 0 (off)
    * Input 1-MAX_BRIGHTNESS maps linearly to minBrightness-HW_MAX
+   * If *fadeTime* (in milliseconds) is not null, the light fades to the new brightness in the
+   * background, see Thyristor::setDelay(..).
    */
-  void setBrightness(uint8_t bri) {
-    static constexpr uint8_t HW_MAX = 255;
-
+  void setBrightness(uint8_t bri, uint16_t fadeTime = 0) {
     // Clamp input to valid range
     if (bri > MAX_BRIGHTNESS) {
       bri = MAX_BRIGHTNESS;
@@ -62,29 +62,40 @@ public:
     // Store input value
     brightness = bri;
 
-    // Map to hardware brightness range
-    uint8_t hwBri;
-    if (bri == 0) {
-      hwBri = 0;  // Always off
-    } else if (mMinBrightness == 0) {
-      // Map 1-MAX_BRIGHTNESS to 0-HW_MAX (simple scaling)
-      hwBri = ((uint16_t)bri * HW_MAX) / MAX_BRIGHTNESS;
-    } else {
-      // Map 1-MAX_BRIGHTNESS to minBrightness-HW_MAX
-      hwBri = mMinBrightness + ((uint16_t)(bri - 1) * (HW_MAX - mMinBrightness)) / (MAX_BRIGHTNESS - 1);
-    }
+    uint8_t hwBri = toHardware(bri);
 
-#ifdef NETWORK_FREQ_FIXED_50HZ
-    uint16_t newDelay = 10000 - (uint16_t)(((uint32_t)hwBri * 10000) / 255);
-#elif defined(NETWORK_FREQ_FIXED_60HZ)
-    uint16_t newDelay = 8333 - (uint16_t)(((uint32_t)hwBri * 8333) / 255);
-#elif defined(NETWORK_FREQ_RUNTIME)
-    uint16_t newDelay =
-      Thyristor::getSemiPeriod() - (uint16_t)(((uint32_t)hwBri * Thyristor::getSemiPeriod()) / 255);
+#ifdef NETWORK_FREQ_RUNTIME
+    thyristor.setPhase(toPhase(hwBri), fadeTime);
+#else
+    thyristor.setDelay(toDelay(hwBri), fadeTime);
 #endif
-    thyristor.setDelay(newDelay);
   };
 
+#ifdef THYRISTOR_COMMAND_QUEUE
+  /**
+   * Like setBrightness(..) without fade, but it can be called from any task or ISR, see
+   * Thyristor::postDelay(..). From the ISRs of ESP8266 and ESP32 prefer Thyristor::postDelay(..),
+   * which is placed in IRAM.
+   */
+  void postBrightness(uint8_t bri) {
+    // Clamp input to valid range
+    if (bri > MAX_BRIGHTNESS) {
+      bri = MAX_BRIGHTNESS;
+    }
+
+    // Store input value
+    brightness = bri;
+
+    uint8_t hwBri = toHardware(bri);
+
+#ifdef NETWORK_FREQ_RUNTIME
+    thyristor.postPhase(toPhase(hwBri));
+#else
+    thyristor.postDelay(toDelay(hwBri));
+#endif
+  }
+#endif
+
   /**
    * Return the current brightness (input scale 0-MAX_BRIGHTNESS).
    */
@@ -128,6 +139,29 @@ public:
     setBrightness(0);
   }
 
+#ifdef THREE_PHASE_ZONES
+  /**
+   * Set the line of the three-phase network the light is wired on, see Thyristor::setZone(..).
+   */
+  void setZone(uint8_t zone) {
+    thyristor.setZone(zone);
+  }
+
+  uint8_t getZone() const {
+    return thyristor.getZone();
+  }
+#endif
+
+#ifdef THYRISTOR_STATS
+  /**
+   * Distance of the scheduled activation from the requested one, see
+   * Thyristor::getDelayError().
+   */
+  int16_t getDelayError() const {
+    return thyristor.getDelayError();
+  }
+#endif
+
   static float getFrequency() {
     return Thyristor::getFrequency();
   }
@@ -143,6 +177,10 @@ public:
     return Thyristor::getDetectedFrequency();
   }
 
+  static uint16_t getZeroCrossJitter() {
+    return Thyristor::getZeroCrossJitter();
+  }
+
   static bool isFrequencyMonitorAlwaysOn() {
     return Thyristor::isFrequencyMonitorAlwaysOn();
   }
@@ -157,10 +195,47 @@ public:
   }
 
   /**
-   * Setup the timer and the interrupt routine.
+   * Setup the timer and the interrupt routine, see Thyristor::begin().
+   */
+  static bool begin() {
+    return Thyristor::begin();
+  }
+
+  /**
+   * Start a batch update: the following setBrightness(..) calls, on any light, are applied all
+   * together by commitUpdate(). Useful to update many lights at once (e.g. every frame of an
+   * effect).
+   */
+  static void beginUpdate() {
+    Thyristor::beginUpdate();
+  }
+
+  /**
+   * Apply all the brightness values set since beginUpdate(), starting from the next zero cross.
    */
-  static void begin() {
-    Thyristor::begin();
+  static void commitUpdate() {
+    Thyristor::commitUpdate();
+  }
+
+  /**
+   * Return true while a batch update is open.
+   */
+  static bool isUpdating() {
+    return Thyristor::isUpdating();
+  }
+
+  /**
+   * Return true when all the lights are fully on or off and no fade is in progress.
+   */
+  static bool isIdle() {
+    return Thyristor::isIdle();
+  }
+
+  /**
+   * Sleep until the next interrupt while idle, see Thyristor::sleepIfIdle().
+   */
+  static bool sleepIfIdle() {
+    return Thyristor::sleepIfIdle();
   }
 
   /**
@@ -194,6 +269,46 @@ public:
 
 private:
   static const uint8_t N = Thyristor::N;
+
+  /**
+   * Map the brightness (input scale, already clamped) to hardware brightness range:
+   * 0 always maps to 0 (off), 1-MAX_BRIGHTNESS maps linearly to minBrightness-HW_MAX.
+   */
+  uint8_t toHardware(uint8_t bri) const {
+    static constexpr uint8_t HW_MAX = 255;
+
+    if (bri == 0) {
+      return 0;  // Always off
+    } else if (mMinBrightness == 0) {
+      // Map 1-MAX_BRIGHTNESS to 0-HW_MAX (simple scaling)
+      return ((uint16_t)bri * HW_MAX) / MAX_BRIGHTNESS;
+    } else {
+      // Map 1-MAX_BRIGHTNESS to minBrightness-HW_MAX
+      return mMinBrightness + ((uint16_t)(bri - 1) * (HW_MAX - mMinBrightness)) / (MAX_BRIGHTNESS - 1);
+    }
+  }
+
+#ifdef NETWORK_FREQ_RUNTIME
+  /**
+   * Activation delay as fraction of the semi-period, so it holds whatever the network frequency
+   * is (UINT16_MAX / 255 == 257).
+   */
+  static uint16_t toPhase(uint8_t hwBri) {
+    return (uint16_t)(255 - hwBri) * 257;
+  }
+#else
+  /**
+   * Activation delay (in microseconds) of the hardware brightness.
+   */
+  static uint16_t toDelay(uint8_t hwBri) {
+#ifdef NETWORK_FREQ_FIXED_50HZ
+    return 10000 - (uint16_t)(((uint32_t)hwBri * 10000) / 255);
+#else
+    return 8333 - (uint16_t)(((uint32_t)hwBri * 8333) / 255);
+#endif
+  }
+#endif
+
   static uint8_t nLights;
 
   Thyristor thyristor;
@@ -19,4 +19,63 @@
  ******************************************************************************/
 #include "dimmable_light_linearized.h"
 
-uint8_t DimmableLightLinearized::nLights = 0;
\ No newline at end of file
+uint8_t DimmableLightLinearized::nLights = 0;
+
+// Tables generated by sampling, for each hardware brightness x in [0;255], the polynomials:
+// 50Hz: -1.5034e-10x^5 + 9.5843e-08x^4 - 2.2953e-05x^3 + 0.0025471x^2 - 0.14965x + 9.9846
+// 60Hz: -1.2528e-10x^5 + 7.9866e-08x^4 - 1.9126e-05x^3 + 0.0021225x^2 - 0.12471x + 8.3201
+// The results (in milliseconds) are multiplied by 1000 and truncated, as the previous "dynamic"
+// computation did.
+#if defined(NETWORK_FREQ_FIXED_50HZ) || defined(NETWORK_FREQ_RUNTIME)
+const uint16_t DimmableLightLinearized::delayTable50Hz[256] PROGMEM = {
+  9984, 9837, 9695, 9557, 9425, 9297, 9173, 9054, 8939, 8827, 8720, 8617,
+  8517, 8421, 8329, 8240, 8154, 8071, 7992, 7915, 7841, 7770, 7702, 7636,
+  7573, 7512, 7454, 7397, 7343, 7291, 7241, 7193, 7147, 7102, 7060, 7018,
+  6979, 6941, 6904, 6869, 6834, 6802, 6770, 6739, 6710, 6681, 6654, 6627,
+  6601, 6576, 6552, 6529, 6506, 6484, 6462, 6441, 6420, 6400, 6380, 6361,
+  6342, 6323, 6305, 6287, 6269, 6251, 6234, 6216, 6199, 6182, 6165, 6148,
+  6131, 6114, 6097, 6080, 6063, 6046, 6029, 6012, 5995, 5977, 5960, 5942,
+  5925, 5907, 5889, 5870, 5852, 5834, 5815, 5796, 5777, 5758, 5738, 5719,
+  5699, 5679, 5659, 5639, 5618, 5597, 5576, 5555, 5534, 5513, 5491, 5469,
+  5447, 5425, 5403, 5381, 5358, 5336, 5313, 5290, 5267, 5244, 5221, 5198,
+  5175, 5151, 5128, 5104, 5081, 5057, 5034, 5010, 4987, 4963, 4940, 4916,
+  4893, 4869, 4846, 4822, 4799, 4776, 4753, 4730, 4707, 4684, 4661, 4638,
+  4616, 4594, 4571, 4549, 4527, 4506, 4484, 4463, 4441, 4420, 4399, 4379,
+  4358, 4338, 4318, 4298, 4278, 4258, 4239, 4219, 4200, 4181, 4163, 4144,
+  4126, 4108, 4090, 4072, 4054, 4036, 4019, 4001, 3984, 3967, 3950, 3933,
+  3916, 3899, 3882, 3865, 3848, 3831, 3814, 3796, 3779, 3762, 3744, 3726,
+  3709, 3690, 3672, 3653, 3634, 3615, 3595, 3575, 3554, 3533, 3511, 3489,
+  3466, 3442, 3418, 3393, 3367, 3341, 3313, 3284, 3255, 3224, 3193, 3160,
+  3126, 3090, 3053, 3015, 2975, 2934, 2891, 2847, 2800, 2752, 2702, 2650,
+  2596, 2540, 2481, 2420, 2357, 2291, 2223, 2152, 2078, 2001, 1921, 1839,
+  1753, 1664, 1571, 1475, 1375, 1272, 1165, 1053, 938, 819, 695, 567,
+  434, 297, 154, 7
+};
+#endif
+
+#if defined(NETWORK_FREQ_FIXED_60HZ) || defined(NETWORK_FREQ_RUNTIME)
+const uint16_t DimmableLightLinearized::delayTable60Hz[256] PROGMEM = {
+  8320, 8197, 8079, 7964, 7854, 7747, 7644, 7544, 7448, 7356, 7266, 7180,
+  7097, 7017, 6940, 6866, 6794, 6725, 6659, 6595, 6534, 6475, 6418, 6363,
+  6310, 6260, 6211, 6164, 6119, 6075, 6034, 5994, 5955, 5918, 5882, 5848,
+  5815, 5783, 5753, 5723, 5695, 5667, 5641, 5616, 5591, 5567, 5544, 5522,
+  5501, 5480, 5460, 5440, 5421, 5402, 5384, 5367, 5350, 5333, 5316, 5300,
+  5284, 5269, 5254, 5238, 5224, 5209, 5194, 5180, 5165, 5151, 5137, 5123,
+  5109, 5095, 5080, 5066, 5052, 5038, 5024, 5009, 4995, 4981, 4966, 4951,
+  4937, 4922, 4907, 4892, 4876, 4861, 4845, 4830, 4814, 4798, 4782, 4765,
+  4749, 4732, 4715, 4698, 4681, 4664, 4647, 4629, 4612, 4594, 4576, 4558,
+  4539, 4521, 4503, 4484, 4465, 4446, 4428, 4409, 4389, 4370, 4351, 4332,
+  4312, 4293, 4273, 4254, 4234, 4215, 4195, 4176, 4156, 4136, 4117, 4097,
+  4078, 4058, 4039, 4019, 4000, 3980, 3961, 3942, 3923, 3904, 3885, 3866,
+  3848, 3829, 3810, 3792, 3774, 3756, 3738, 3720, 3702, 3685, 3667, 3650,
+  3633, 3616, 3599, 3583, 3566, 3550, 3534, 3518, 3502, 3486, 3471, 3455,
+  3440, 3425, 3410, 3395, 3380, 3366, 3351, 3337, 3322, 3308, 3294, 3280,
+  3266, 3251, 3237, 3223, 3209, 3195, 3181, 3167, 3152, 3138, 3123, 3109,
+  3094, 3079, 3063, 3048, 3032, 3016, 3000, 2983, 2966, 2948, 2930, 2912,
+  2892, 2873, 2853, 2832, 2811, 2788, 2765, 2742, 2717, 2692, 2665, 2638,
+  2610, 2580, 2550, 2518, 2485, 2451, 2415, 2378, 2339, 2299, 2258, 2214,
+  2169, 2123, 2074, 2023, 1971, 1916, 1859, 1800, 1738, 1675, 1608, 1539,
+  1468, 1394, 1317, 1237, 1154, 1068, 978, 886, 790, 690, 587, 481,
+  370, 256, 137, 15
+};
+#endif
@@ -22,6 +22,7 @@
 #define DIMMABLE_LIGHT_LINEARIZED_H
 
 #include "thyristor.h"
+#include "power_curve.h"
 #include <Arduino.h>
 
 /**
@@ -30,15 +31,17 @@
  * "brightness" meaning: here the brightness it mapped linearly to
  * power delivered to your devices, in DimmableLight it is linearly mapped
  * to time point when thyristor is triggered.
- * The computation induced by this class may affect the performance of your MCU.
+ * The mapping is read from a precomputed table stored in flash, hence it costs as much as
+ * DimmableLight::setBrightness(..). By default the table is fitted on incandescent bulbs, any
+ * other load can be given its own curve, see PowerCurve.
  */
 class DimmableLightLinearized {
 public:
   static constexpr uint8_t MAX_BRIGHTNESS = 200;
   static constexpr uint8_t MAX_MIN_BRIGHTNESS = 55;  // Ensures 200 levels (55-255)
 
-  DimmableLightLinearized(int pin, uint8_t minBrightness = 0)
-    : thyristor(pin), brightness(0), mMinBrightness(minBrightness > MAX_MIN_BRIGHTNESS ? MAX_MIN_BRIGHTNESS : minBrightness) {
+  DimmableLightLinearized(int pin, uint8_t minBrightness = 0, const uint16_t* curve = nullptr)
+    : thyristor(pin), curve(curve), brightness(0), mMinBrightness(minBrightness > MAX_MIN_BRIGHTNESS ? MAX_MIN_BRIGHTNESS : minBrightness) {
     if (nLights < N) {
       nLights++;
     } else {
@@ -53,10 +56,11 @@ public:
    * Maps to hardware range minBrightness-HW_MAX
    * Input 0 always maps to hardware 0 (off)
    * Input 1-MAX_BRIGHTNESS maps linearly to minBrightness-HW_MAX
+   * If *fadeTime* (in milliseconds) is not null, the light fades to the new brightness in the
+   * background, see Thyristor::setDelay(..). The intermediate steps are linear in the activation
+   * delay, not in power.
    */
-  void setBrightness(uint8_t bri) {
-    static constexpr uint8_t HW_MAX = 255;
-
+  void setBrightness(uint8_t bri, uint16_t fadeTime = 0) {
     // Clamp input to valid range
     if (bri > MAX_BRIGHTNESS) {
       bri = MAX_BRIGHTNESS;
@@ -65,47 +69,72 @@ public:
     // Store input value
     brightness = bri;
 
-    // Map to hardware brightness range
-    uint8_t hwBri;
-    if (bri == 0) {
-      hwBri = 0;  // Always off
-    } else if (mMinBrightness == 0) {
-      // Map 1-MAX_BRIGHTNESS to 0-HW_MAX (simple scaling)
-      hwBri = ((uint16_t)bri * HW_MAX) / MAX_BRIGHTNESS;
-    } else {
-      // Map 1-MAX_BRIGHTNESS to minBrightness-HW_MAX
-      hwBri = mMinBrightness + ((uint16_t)(bri - 1) * (HW_MAX - mMinBrightness)) / (MAX_BRIGHTNESS - 1);
+    uint8_t hwBri = toHardware(bri);
+
+    if (curve != nullptr) {
+#ifdef NETWORK_FREQ_RUNTIME
+      thyristor.setPhase(PowerCurve::getPhase(curve, hwBri), fadeTime);
+#else
+      thyristor.setDelay(PowerCurve::getDelay(curve, hwBri, Thyristor::getSemiPeriod()), fadeTime);
+#endif
+      return;
     }
 
-#ifdef NETWORK_FREQ_FIXED_50HZ
-    double tempBrightness = -1.5034e-10 * pow(hwBri, 5) + 9.5843e-08 * pow(hwBri, 4)
-                            - 2.2953e-05 * pow(hwBri, 3) + 0.0025471 * pow(hwBri, 2) - 0.14965 * hwBri + 9.9846;
+#if defined(NETWORK_FREQ_FIXED_50HZ)
+    thyristor.setDelay(pgm_read_word(&delayTable50Hz[hwBri]), fadeTime);
 #elif defined(NETWORK_FREQ_FIXED_60HZ)
-    double tempBrightness = -1.2528e-10 * pow(hwBri, 5) + 7.9866e-08 * pow(hwBri, 4)
-                            - 1.9126e-05 * pow(hwBri, 3) + 0.0021225 * pow(hwBri, 2) - 0.12471 * hwBri + 8.3201;
+    thyristor.setDelay(pgm_read_word(&delayTable60Hz[hwBri]), fadeTime);
 #elif defined(NETWORK_FREQ_RUNTIME)
-    double tempBrightness;
-    if (Thyristor::getFrequency() == 50) {
-      tempBrightness = -1.5034e-10 * pow(hwBri, 5) + 9.5843e-08 * pow(hwBri, 4)
-                       - 2.2953e-05 * pow(hwBri, 3) + 0.0025471 * pow(hwBri, 2) - 0.14965 * hwBri + 9.9846;
-    } else if (Thyristor::getFrequency() == 60) {
-      tempBrightness = -1.2528e-10 * pow(hwBri, 5) + 7.9866e-08 * pow(hwBri, 4)
-                       - 1.9126e-05 * pow(hwBri, 3) + 0.0021225 * pow(hwBri, 2) - 0.12471 * hwBri + 8.3201;
-    } else {
-      // Only on and off
-      if (hwBri > 0) {
-        thyristor.turnOn();
-      } else {
-        thyristor.turnOff();
-      }
+    const uint16_t* delayTable = getDelayTable();
+    if (delayTable == nullptr) {
+      // Only fully on and off, kept when the frequency is detected
+      thyristor.setPhase(hwBri > 0 ? 0 : UINT16_MAX, fadeTime);
       return;
     }
+    thyristor.setPhase(tablePhase(delayTable, hwBri), fadeTime);
 #endif
-    tempBrightness *= 1000;
-
-    thyristor.setDelay(tempBrightness);
   };
 
+#ifdef THYRISTOR_COMMAND_QUEUE
+  /**
+   * Like setBrightness(..) without fade, but it can be called from any task or ISR, see
+   * Thyristor::postDelay(..). From the ISRs of ESP8266 and ESP32 prefer Thyristor::postDelay(..),
+   * which is placed in IRAM.
+   */
+  void postBrightness(uint8_t bri) {
+    // Clamp input to valid range
+    if (bri > MAX_BRIGHTNESS) {
+      bri = MAX_BRIGHTNESS;
+    }
+
+    // Store input value
+    brightness = bri;
+
+    uint8_t hwBri = toHardware(bri);
+
+#if defined(NETWORK_FREQ_FIXED_50HZ)
+    thyristor.postDelay(curve != nullptr ? PowerCurve::getDelay(curve, hwBri, 10000)
+                                         : pgm_read_word(&delayTable50Hz[hwBri]));
+#elif defined(NETWORK_FREQ_FIXED_60HZ)
+    thyristor.postDelay(curve != nullptr ? PowerCurve::getDelay(curve, hwBri, 8333)
+                                         : pgm_read_word(&delayTable60Hz[hwBri]));
+#elif defined(NETWORK_FREQ_RUNTIME)
+    if (curve != nullptr) {
+      thyristor.postPhase(PowerCurve::getPhase(curve, hwBri));
+      return;
+    }
+    // The same table as setBrightness(..), selected without the cache of getDelayTable()
+    const uint16_t* delayTable = delayTableFor(Thyristor::peekSemiPeriod());
+    if (delayTable == nullptr) {
+      // Only fully on and off, as setBrightness(..)
+      thyristor.postPhase(hwBri > 0 ? 0 : UINT16_MAX);
+      return;
+    }
+    thyristor.postPhase(tablePhase(delayTable, hwBri));
+#endif
+  }
+#endif
+
   /**
    * Return the current brightness (input scale 0-MAX_BRIGHTNESS).
    */
@@ -135,6 +164,25 @@ public:
     }
   }
 
+  /**
+   * Return the curve of the load, nullptr for the default one.
+   */
+  const uint16_t* getCurve() const {
+    return curve;
+  }
+
+  /**
+   * Set the curve of the load (e.g. PowerCurve::resistive, or a user one stored in flash),
+   * nullptr for the default one fitted on incandescent bulbs. The curve is not copied.
+   */
+  void setCurve(const uint16_t* newCurve) {
+    curve = newCurve;
+    // Reapply current brightness with new mapping
+    if (brightness > 0) {
+      setBrightness(brightness);
+    }
+  }
+
   /**
    * Turn off the light.
    */
@@ -142,6 +190,29 @@ public:
     setBrightness(0);
   }
 
+#ifdef THREE_PHASE_ZONES
+  /**
+   * Set the line of the three-phase network the light is wired on, see Thyristor::setZone(..).
+   */
+  void setZone(uint8_t zone) {
+    thyristor.setZone(zone);
+  }
+
+  uint8_t getZone() const {
+    return thyristor.getZone();
+  }
+#endif
+
+#ifdef THYRISTOR_STATS
+  /**
+   * Distance of the scheduled activation from the requested one, see
+   * Thyristor::getDelayError().
+   */
+  int16_t getDelayError() const {
+    return thyristor.getDelayError();
+  }
+#endif
+
   static float getFrequency() {
     return Thyristor::getFrequency();
   }
@@ -157,6 +228,10 @@ public:
     return Thyristor::getDetectedFrequency();
   }
 
+  static uint16_t getZeroCrossJitter() {
+    return Thyristor::getZeroCrossJitter();
+  }
+
   static bool isFrequencyMonitorAlwaysOn() {
     return Thyristor::isFrequencyMonitorAlwaysOn();
   }
@@ -171,10 +246,47 @@ public:
   }
 
   /**
-   * Setup the timer and the interrupt routine.
+   * Setup the timer and the interrupt routine, see Thyristor::begin().
+   */
+  static bool begin() {
+    return Thyristor::begin();
+  }
+
+  /**
+   * Start a batch update: the following setBrightness(..) calls, on any light, are applied all
+   * together by commitUpdate(). Useful to update many lights at once (e.g. every frame of an
+   * effect).
+   */
+  static void beginUpdate() {
+    Thyristor::beginUpdate();
+  }
+
+  /**
+   * Apply all the brightness values set since beginUpdate(), starting from the next zero cross.
+   */
+  static void commitUpdate() {
+    Thyristor::commitUpdate();
+  }
+
+  /**
+   * Return true while a batch update is open.
+   */
+  static bool isUpdating() {
+    return Thyristor::isUpdating();
+  }
+
+  /**
+   * Return true when all the lights are fully on or off and no fade is in progress.
+   */
+  static bool isIdle() {
+    return Thyristor::isIdle();
+  }
+
+  /**
+   * Sleep until the next interrupt while idle, see Thyristor::sleepIfIdle().
    */
-  static void begin() {
-    Thyristor::begin();
+  static bool sleepIfIdle() {
+    return Thyristor::sleepIfIdle();
   }
 
   /**
@@ -207,11 +319,84 @@ public:
   };
 
 private:
-  static const uint8_t N = 8;
+  static const uint8_t N = Thyristor::N;
+
+  /**
+   * Map the brightness (input scale, already clamped) to hardware brightness range:
+   * 0 always maps to 0 (off), 1-MAX_BRIGHTNESS maps linearly to minBrightness-HW_MAX.
+   */
+  uint8_t toHardware(uint8_t bri) const {
+    static constexpr uint8_t HW_MAX = 255;
+
+    if (bri == 0) {
+      return 0;  // Always off
+    } else if (mMinBrightness == 0) {
+      // Map 1-MAX_BRIGHTNESS to 0-HW_MAX (simple scaling)
+      return ((uint16_t)bri * HW_MAX) / MAX_BRIGHTNESS;
+    } else {
+      // Map 1-MAX_BRIGHTNESS to minBrightness-HW_MAX
+      return mMinBrightness + ((uint16_t)(bri - 1) * (HW_MAX - mMinBrightness)) / (MAX_BRIGHTNESS - 1);
+    }
+  }
+
+
+  /**
+   * Activation delays (in microseconds) indexed by hardware brightness, stored in flash.
+   * They sample the 5th order polynomials fitted on incandescence bulbs.
+   */
+#if defined(NETWORK_FREQ_FIXED_50HZ) || defined(NETWORK_FREQ_RUNTIME)
+  static const uint16_t delayTable50Hz[256];
+#endif
+#if defined(NETWORK_FREQ_FIXED_60HZ) || defined(NETWORK_FREQ_RUNTIME)
+  static const uint16_t delayTable60Hz[256];
+#endif
+
+#ifdef NETWORK_FREQ_RUNTIME
+  /**
+   * Return the table of the nominal frequency nearest to the current one, nullptr while it is
+   * unknown. The table is selected again only when the semi-period changes.
+   */
+  static const uint16_t* getDelayTable() {
+    static uint16_t lastSemiPeriod = 0;
+    static const uint16_t* delayTable = nullptr;
+
+    uint16_t semiPeriod = Thyristor::getSemiPeriod();
+    if (semiPeriod != lastSemiPeriod) {
+      lastSemiPeriod = semiPeriod;
+      delayTable = delayTableFor(semiPeriod);
+    }
+    return delayTable;
+  }
+
+  /**
+   * Return the table of the nominal frequency nearest to *semiPeriod*, nullptr if it is 0.
+   */
+  static const uint16_t* delayTableFor(uint16_t semiPeriod) {
+    if (semiPeriod == 0) {
+      return nullptr;
+    }
+    return semiPeriod > (10000 + 8333) / 2 ? delayTable50Hz : delayTable60Hz;
+  }
+
+  /**
+   * Return the delay of *delayTable* for *hwBri* as fraction of the nominal semi-period of the
+   * table, so it follows the drift of the network.
+   */
+  static uint16_t tablePhase(const uint16_t* delayTable, uint8_t hwBri) {
+    uint32_t phase = ((uint32_t)pgm_read_word(&delayTable[hwBri]) << 16)
+                     / (delayTable == delayTable50Hz ? 10000 : 8333);
+    return phase > UINT16_MAX ? UINT16_MAX : phase;
+  }
+#endif
   static uint8_t nLights;
 
   Thyristor thyristor;
 
+  /**
+   * Curve of the load in flash, see PowerCurve. If nullptr, the tables above are used.
+   */
+  const uint16_t* curve;
+
   /**
    * Store the current brightness (input scale 0-MAX_BRIGHTNESS).
    */
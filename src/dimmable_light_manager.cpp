@@ -19,46 +19,78 @@
  ******************************************************************************/
 #include "dimmable_light_manager.h"
 
-bool DimmableLightManager::add(String lightName, uint8_t pin) {
-  const char* temp = lightName.c_str();
-#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_RP2040)
-  std::unordered_map<std::string, DimmableLight*>::const_iterator it = dla.find(temp);
-#elif defined(AVR)
-  std::map<std::string, DimmableLight*>::const_iterator it = dla.find(temp);
-#endif
-  if (it == dla.end()) {
-    DimmableLight* pDimLight = new DimmableLight(pin);
-    dla.insert({ lightName.c_str(), pDimLight });
-    return true;
-  } else {
-    return false;
+DimmableLightManager::~DimmableLightManager() {
+  for (uint8_t i = 0; i < count; i++) { light(i)->~DimmableLight(); }
+}
+
+uint32_t DimmableLightManager::hash(const char* name, size_t length) {
+  uint32_t h = 2166136261ul;
+  for (size_t i = 0; i < length; i++) {
+    h ^= (uint8_t)name[i];
+    h *= 16777619ul;
   }
+  return h;
 }
 
-DimmableLight* DimmableLightManager::get(String lightName) {
-  const char* temp = lightName.c_str();
-#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_RP2040)
-  std::unordered_map<std::string, DimmableLight*>::const_iterator it = dla.find(temp);
-#elif defined(AVR)
-  std::map<std::string, DimmableLight*>::const_iterator it = dla.find(temp);
-#endif
-  if (it != dla.end()) {
-    return (it->second);
-  } else {
-    return nullptr;
+uint16_t DimmableLightManager::find(const char* name, size_t length) const {
+  // Linear probing: the table is never full, so an empty slot is always reached
+  uint16_t slot = hash(name, length) & (TABLE_SIZE - 1);
+  while (slots[slot]) {
+    const char* stored = names[slots[slot] - 1];
+    if (strncmp(stored, name, length) == 0 && stored[length] == '\0') { return slot; }
+    slot = (slot + 1) & (TABLE_SIZE - 1);
   }
+  return slot;
+}
+
+bool DimmableLightManager::add(const char* lightName, uint8_t pin) {
+  size_t length = strlen(lightName);
+  if (length == 0 || length > LIGHT_NAME_MAX_LENGTH || count == N) { return false; }
+
+  uint16_t slot = find(lightName, length);
+  if (slots[slot]) { return false; }
+
+  memcpy(names[count], lightName, length + 1);
+  new (pool[count]) DimmableLight(pin);
+  count++;
+  slots[slot] = count;
+  return true;
+}
+
+DimmableLight* DimmableLightManager::get(const char* lightName, size_t length) {
+  return at(resolve(lightName, length));
 }
 
-std::pair<String, DimmableLight*> DimmableLightManager::get() {
-#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_RP2040)
-  static std::unordered_map<std::string, DimmableLight*>::const_iterator it = dla.begin();
-#elif defined(AVR)
-  static std::map<std::string, DimmableLight*>::const_iterator it = dla.begin();
-#endif
-  String name = it->first.c_str();
-  std::pair<String, DimmableLight*> res(name, it->second);
+DimmableLightManager::Handle DimmableLightManager::resolve(const char* lightName, size_t length) {
+  if (length > LIGHT_NAME_MAX_LENGTH) { return INVALID_HANDLE; }
+  uint16_t slot = find(lightName, length);
+  return slots[slot] ? slots[slot] - 1 : INVALID_HANDLE;
+}
+
+bool DimmableLightManager::Scene::set(Handle handle, uint8_t brightness) {
+  if (handle >= Thyristor::N) { return false; }
+  uint8_t i = 0;
+  while (i < count && items[i].handle != handle) { i++; }
+  if (i == count) {
+    items[i].handle = handle;
+    count++;
+  }
+  items[i].brightness = brightness;
+  return true;
+}
+
+void DimmableLightManager::apply(const Scene& scene, uint16_t fadeTime) {
+  bool batch = !DimmableLight::isUpdating();
+  if (batch) { DimmableLight::beginUpdate(); }
+  for (uint8_t i = 0; i < scene.count; i++) {
+    DimmableLight* l = at(scene.items[i].handle);
+    if (l) { l->setBrightness(scene.items[i].brightness, fadeTime); }
+  }
+  if (batch) { DimmableLight::commitUpdate(); }
+}
 
-  it++;
-  if (it == dla.end()) { it = dla.begin(); }
-  return res;
+DimmableLightManager::Entry DimmableLightManager::get() {
+  if (count == 0) { return { nullptr, nullptr }; }
+  if (cursor >= count) { cursor = 0; }
+  return entry(cursor++);
 }
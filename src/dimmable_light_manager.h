@@ -22,57 +22,306 @@
 
 #include "dimmable_light.h"
 
-#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_RP2040)
-// Unfortunately Arduino defines max/min macros, those create conflicts with the one
-// defined by C++/STL environment
-#undef max
-#undef min
-#include <unordered_map>
-#elif defined(AVR)
-#include <ArduinoSTL.h>
-#include <map>
+#if defined(ARDUINO_ARCH_AVR)
+#include <new.h>
+#else
+#include <new>
+#include <utility>
 #endif
 
-#include <string>
+// Maximum length of the names given to the lights, the terminator excluded. The names are stored
+// inside the manager, so it affects the RAM usage.
+#ifndef LIGHT_NAME_MAX_LENGTH
+#define LIGHT_NAME_MAX_LENGTH 15
+#endif
+
+namespace dimmable_light_detail {
+/**
+ * Smallest power of 2 not lower than *minSize*.
+ */
+constexpr uint16_t lightTableSize(uint16_t minSize, uint16_t size = 1) {
+  return size >= minSize ? size : lightTableSize(minSize, size * 2);
+}
+}  // namespace dimmable_light_detail
 
 /**
  * Class to store the mapping between a DimmableLight object and
  * a (friendly) name. This could be useful when developing APIs.
+ *
+ * It doesn't use the heap: the lights are constructed in a pool inside the manager, as many as
+ * THYRISTOR_MAX_NUMBER, and they are located through an open-addressing hash table of their names.
  */
 class DimmableLightManager {
 public:
   /**
-   * Create a new light with a given name
+   * A light with its name.
+   */
+  struct Entry {
+    const char* name;
+    DimmableLight* light;
+
+#if !defined(ARDUINO_ARCH_AVR)
+    /**
+     * Conversion to the pair returned by get() up to version 1.x, so that
+     * `std::pair<String, DimmableLight*> p = dlm.get();` still compiles.
+     */
+    operator std::pair<String, DimmableLight*>() const {
+      return std::pair<String, DimmableLight*>(name != nullptr ? name : "", light);
+    }
+#endif
+  };
+
+  /**
+   * Compact reference to a light of this manager, see resolve(..).
+   */
+  typedef uint8_t Handle;
+
+  /**
+   * Handle of no light.
+   */
+  static const Handle INVALID_HANDLE = UINT8_MAX;
+
+  /**
+   * A set of brightness values for some lights, applied all together by apply(..). Lights are
+   * referenced by handle, so a scene is bound to the manager that resolved them.
+   */
+  class Scene {
+  public:
+    Scene() : count(0) {}
+
+    /**
+     * Set the brightness of a light in this scene, replacing the previous one if already set.
+     * Return false if the handle is invalid.
+     */
+    bool set(Handle handle, uint8_t brightness);
+
+    /**
+     * Remove all the lights from this scene.
+     */
+    void clear() {
+      count = 0;
+    }
+
+    uint8_t getCount() const {
+      return count;
+    }
+
+  private:
+    struct Item {
+      Handle handle;
+      uint8_t brightness;
+    };
+
+    // Each light appears at most once
+    Item items[Thyristor::N];
+    uint8_t count;
+
+    friend class DimmableLightManager;
+  };
+
+  /**
+   * Forward iterator over the lights of a manager, in insertion order.
+   */
+  class Iterator {
+  public:
+    Entry operator*() const {
+      return manager->entry(index);
+    }
+
+    Iterator& operator++() {
+      index++;
+      return *this;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return index == other.index;
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return index != other.index;
+    }
+
+  private:
+    Iterator(DimmableLightManager* manager, uint8_t index) : manager(manager), index(index) {}
+
+    DimmableLightManager* manager;
+    uint8_t index;
+
+    friend class DimmableLightManager;
+  };
+
+  /**
+   * The lights of a manager at the time it was created, see lights().
+   */
+  class Range {
+  public:
+    Iterator begin() const {
+      return first;
+    }
+
+    Iterator end() const {
+      return last;
+    }
+
+  private:
+    Range(Iterator first, Iterator last) : first(first), last(last) {}
+
+    Iterator first;
+    Iterator last;
+
+    friend class DimmableLightManager;
+  };
+
+  DimmableLightManager() : count(0), cursor(0), slots() {}
+  DimmableLightManager(DimmableLightManager const&) = delete;
+  void operator=(DimmableLightManager const&) = delete;
+
+  ~DimmableLightManager();
+
+  /**
+   * Create a new light with a given name. Return false if the name is already used, if it is
+   * empty or longer than LIGHT_NAME_MAX_LENGTH, or if the manager is full.
    */
-  bool add(String lightName, uint8_t pin);
+  bool add(const char* lightName, uint8_t pin);
+
+  bool add(const String& lightName, uint8_t pin) {
+    return add(lightName.c_str(), pin);
+  }
 
   /**
    * Get a light with a specific name, if any
    */
-  DimmableLight* get(String lightName);
+  DimmableLight* get(const char* lightName) {
+    return get(lightName, strlen(lightName));
+  }
+
+  /**
+   * Get a light from the first *length* chars of *lightName*, that may be not null-terminated
+   * (e.g. a token inside a MQTT topic).
+   */
+  DimmableLight* get(const char* lightName, size_t length);
+
+  DimmableLight* get(const String& lightName) {
+    return get(lightName.c_str(), lightName.length());
+  }
+
+  /**
+   * Return the handle of the light with a specific name, INVALID_HANDLE if there is none. Resolve
+   * the names once, then refer to the lights by handle to skip the lookups.
+   */
+  Handle resolve(const char* lightName) {
+    return resolve(lightName, strlen(lightName));
+  }
+
+  Handle resolve(const char* lightName, size_t length);
+
+  Handle resolve(const String& lightName) {
+    return resolve(lightName.c_str(), lightName.length());
+  }
+
+  /**
+   * Get a light from its handle, nullptr if invalid.
+   */
+  DimmableLight* at(Handle handle) {
+    return handle < count ? light(handle) : nullptr;
+  }
+
+  /**
+   * Set all the lights of a scene within a single batch update, so the schedule is prepared only
+   * once. If *fadeTime* (in milliseconds) is not null, every light fades to its brightness. If a
+   * batch update is already open, the scene joins it and it is applied by its commit.
+   */
+  void apply(const Scene& scene, uint16_t fadeTime = 0);
 
   /**
    * Get a light from from the contaniner.
    *
    * This method is "circular", that means once you get the last element
-   * the nect call return the first one.
+   * the nect call return the first one. Lights are returned in insertion order, each manager
+   * has its own cursor and adding lights doesn't reset it.
+   */
+  Entry get();
+
+  /**
+   * Return the lights for a range-based for loop, in insertion order:
+   *
+   *     for (DimmableLightManager::Entry e : dlm.lights()) { ... }
+   *
+   * Lights never move, so the iteration is not affected by add(..): the lights added meanwhile
+   * are just not visited.
    */
-  std::pair<String, DimmableLight*> get();
+  Range lights() {
+    return Range(Iterator(this, 0), Iterator(this, count));
+  }
+
+  int getCount() const {
+    return count;
+  }
 
-  int getCount() {
-    return dla.size();
+  static bool begin() {
+    return DimmableLight::begin();
   }
 
-  static void begin() {
-    DimmableLight::begin();
+  /**
+   * Start a batch update, see DimmableLight::beginUpdate().
+   */
+  static void beginUpdate() {
+    DimmableLight::beginUpdate();
+  }
+
+  /**
+   * Apply the batch update, see DimmableLight::commitUpdate().
+   */
+  static void commitUpdate() {
+    DimmableLight::commitUpdate();
   }
 
 private:
-#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_RP2040)
-  std::unordered_map<std::string, DimmableLight*> dla;
-#elif defined(AVR)
-  std::map<std::string, DimmableLight*> dla;
-#endif
+  static const uint8_t N = Thyristor::N;
+
+  /**
+   * Size of the hash table, a power of 2 at least twice the number of lights, so the probe
+   * sequences stay short.
+   */
+  static const uint16_t TABLE_SIZE = dimmable_light_detail::lightTableSize(2 * N);
+
+  /**
+   * Hash of a name (32-bit FNV-1a).
+   */
+  static uint32_t hash(const char* name, size_t length);
+
+  /**
+   * Return the slot of the hash table holding the given name, or the empty slot where it should
+   * be inserted.
+   */
+  uint16_t find(const char* name, size_t length) const;
+
+  DimmableLight* light(uint8_t i) {
+    return reinterpret_cast<DimmableLight*>(pool[i]);
+  }
+
+  Entry entry(uint8_t i) {
+    return { names[i], light(i) };
+  }
+
+  uint8_t count;
+
+  /**
+   * Position of the next light returned by get().
+   */
+  uint8_t cursor;
+
+  /**
+   * Hash table: index + 1 of the light in the pool, 0 if empty.
+   */
+  uint8_t slots[TABLE_SIZE];
+
+  char names[N][LIGHT_NAME_MAX_LENGTH + 1];
+
+  /**
+   * Storage of the lights, constructed in place by add().
+   */
+  alignas(DimmableLight) uint8_t pool[N][sizeof(DimmableLight)];
 };
 
 #endif
@@ -0,0 +1,196 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+/***********************************************************************************
+ * Minimalistic "fast GPIO" layer used by the ISRs to drive the thyristors' gates.
+ * A pin is translated once into a (port, mask) pair, then it is switched by writing
+ * directly the output registers, skipping all the checks done by digitalWrite(..).
+ * Pins sharing the same port can be switched together by OR-ing their masks.
+ * GPIO_PORTS is the maximum number of ports, i.e. of the masks needed to switch any set of pins.
+ ***********************************************************************************/
+#ifndef FAST_GPIO_H
+#define FAST_GPIO_H
+
+#include <Arduino.h>
+
+// Called from ISRs, see THYRISTOR_ISR_ATTR in thyristor.cpp
+#define FAST_GPIO_INLINE static inline __attribute__((always_inline))
+
+#if defined(ARDUINO_ARCH_AVR)
+
+// Output register (PORTx) and bit mask
+typedef volatile uint8_t *gpio_port_t;
+typedef uint8_t gpio_mask_t;
+
+// PORTA..PORTL on the biggest ones (ATmega2560)
+#define GPIO_PORTS 12
+
+FAST_GPIO_INLINE gpio_port_t gpioPort(uint8_t pin) {
+  return portOutputRegister(digitalPinToPort(pin));
+}
+
+FAST_GPIO_INLINE gpio_mask_t gpioMask(uint8_t pin) {
+  return digitalPinToBitMask(pin);
+}
+
+// Read-modify-write: it is atomic only inside an ISR (or with interrupts disabled), but
+// digitalWrite(..) on AVR disables interrupts while touching the same registers.
+FAST_GPIO_INLINE void gpioSet(gpio_port_t port, gpio_mask_t mask) {
+  *port |= mask;
+}
+
+FAST_GPIO_INLINE void gpioClear(gpio_port_t port, gpio_mask_t mask) {
+  *port &= ~mask;
+}
+
+#elif defined(ARDUINO_ARCH_ESP8266)
+
+// 0: GPIO0-15 (GPOS/GPOC registers), 1: GPIO16 (RTC domain)
+typedef uint8_t gpio_port_t;
+typedef uint16_t gpio_mask_t;
+
+#define GPIO_PORTS 2
+
+FAST_GPIO_INLINE gpio_port_t gpioPort(uint8_t pin) {
+  return pin < 16 ? 0 : 1;
+}
+
+FAST_GPIO_INLINE gpio_mask_t gpioMask(uint8_t pin) {
+  return pin < 16 ? 1 << pin : 1;
+}
+
+FAST_GPIO_INLINE void gpioSet(gpio_port_t port, gpio_mask_t mask) {
+  if (port == 0) {
+    GPOS = mask;
+  } else {
+    GP16O |= mask;
+  }
+}
+
+FAST_GPIO_INLINE void gpioClear(gpio_port_t port, gpio_mask_t mask) {
+  if (port == 0) {
+    GPOC = mask;
+  } else {
+    GP16O &= ~mask;
+  }
+}
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#include <soc/gpio_reg.h>
+
+// 0: GPIO0-31 (GPIO_OUT_W1TS/W1TC registers), 1: GPIO32-39 (GPIO_OUT1_W1TS/W1TC registers)
+typedef uint8_t gpio_port_t;
+typedef uint32_t gpio_mask_t;
+
+#define GPIO_PORTS 2
+
+FAST_GPIO_INLINE gpio_port_t gpioPort(uint8_t pin) {
+  return pin < 32 ? 0 : 1;
+}
+
+FAST_GPIO_INLINE gpio_mask_t gpioMask(uint8_t pin) {
+  return 1ul << (pin & 31);
+}
+
+FAST_GPIO_INLINE void gpioSet(gpio_port_t port, gpio_mask_t mask) {
+#ifdef GPIO_OUT1_W1TS_REG
+  if (port) {
+    REG_WRITE(GPIO_OUT1_W1TS_REG, mask);
+    return;
+  }
+#endif
+  REG_WRITE(GPIO_OUT_W1TS_REG, mask);
+}
+
+FAST_GPIO_INLINE void gpioClear(gpio_port_t port, gpio_mask_t mask) {
+#ifdef GPIO_OUT1_W1TC_REG
+  if (port) {
+    REG_WRITE(GPIO_OUT1_W1TC_REG, mask);
+    return;
+  }
+#endif
+  REG_WRITE(GPIO_OUT_W1TC_REG, mask);
+}
+
+#elif defined(ARDUINO_ARCH_SAMD)
+
+// Index of PORT group and bit mask
+typedef uint8_t gpio_port_t;
+typedef uint32_t gpio_mask_t;
+
+// PORTA..PORTD on the biggest SAMD51
+#define GPIO_PORTS 4
+
+FAST_GPIO_INLINE gpio_port_t gpioPort(uint8_t pin) {
+  return g_APinDescription[pin].ulPort;
+}
+
+FAST_GPIO_INLINE gpio_mask_t gpioMask(uint8_t pin) {
+  return 1ul << g_APinDescription[pin].ulPin;
+}
+
+FAST_GPIO_INLINE void gpioSet(gpio_port_t port, gpio_mask_t mask) {
+  PORT->Group[port].OUTSET.reg = mask;
+}
+
+FAST_GPIO_INLINE void gpioClear(gpio_port_t port, gpio_mask_t mask) {
+  PORT->Group[port].OUTCLR.reg = mask;
+}
+
+#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+
+#include <hardware/gpio.h>
+
+// All the GPIOs belong to a single bank driven by SIO set/clear registers
+typedef uint8_t gpio_port_t;
+typedef uint32_t gpio_mask_t;
+
+#define GPIO_PORTS 1
+
+FAST_GPIO_INLINE gpio_port_t gpioPort(uint8_t) {
+  return 0;
+}
+
+FAST_GPIO_INLINE gpio_mask_t gpioMask(uint8_t pin) {
+  return 1ul << pin;
+}
+
+FAST_GPIO_INLINE void gpioSet(gpio_port_t, gpio_mask_t mask) {
+  gpio_set_mask(mask);
+}
+
+FAST_GPIO_INLINE void gpioClear(gpio_port_t, gpio_mask_t mask) {
+  gpio_clr_mask(mask);
+}
+
+#else
+#error "only ESP8266, ESP32, AVR, SAMD & RP2040 (non-mbed) architectures are supported"
+#endif
+
+/**
+ * A set of pins belonging to the same port.
+ */
+struct GpioPortMask {
+  gpio_port_t port;
+  gpio_mask_t mask;
+};
+
+#endif  // END FAST_GPIO_H
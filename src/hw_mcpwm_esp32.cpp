@@ -0,0 +1,113 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+#include "thyristor.h"
+
+#ifdef ESP32_MCPWM_GATES
+
+#include "hw_mcpwm_esp32.h"
+#include <driver/mcpwm.h>
+#include <soc/soc_caps.h>
+
+#if !SOC_MCPWM_SUPPORTED
+#error "this ESP32 variant has no MCPWM peripheral, disable ESP32_MCPWM_GATES"
+#endif
+
+static mcpwm_unit_t unitOf(uint8_t channel) {
+  return channel < 6 ? MCPWM_UNIT_0 : MCPWM_UNIT_1;
+}
+
+static mcpwm_timer_t timerOf(uint8_t channel) {
+  return (mcpwm_timer_t)((channel % 6) / 2);
+}
+
+static mcpwm_operator_t generatorOf(uint8_t channel) {
+  return channel % 2 ? MCPWM_OPR_B : MCPWM_OPR_A;
+}
+
+void mcpwmGatesAttach(uint8_t channel, uint8_t pin) {
+  // Output signals are ordered as MCPWM0A, MCPWM0B, MCPWM1A, ..., MCPWM2B
+  mcpwm_io_signals_t signal = (mcpwm_io_signals_t)(timerOf(channel) * 2 + generatorOf(channel));
+  mcpwm_gpio_init(unitOf(channel), signal, pin);
+}
+
+/**
+ * The driver accepts only integer frequencies: round it up, so the gates are
+ * turned off before *maxPeriod*.
+ */
+static uint32_t periodToFrequency(uint16_t maxPeriod) {
+  return (1000000 + maxPeriod - 1) / maxPeriod;
+}
+
+uint16_t mcpwmGatesBegin(uint8_t syncPin, uint8_t nChannels, uint16_t maxPeriod) {
+  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM_SYNC_0, syncPin);
+  if (nChannels > 6) { mcpwm_gpio_init(MCPWM_UNIT_1, MCPWM_SYNC_0, syncPin); }
+
+  mcpwm_config_t config;
+  config.frequency = periodToFrequency(maxPeriod);
+  config.cmpr_a = 100;
+  config.cmpr_b = 100;
+  config.counter_mode = MCPWM_UP_COUNTER;
+  // Output low at the (re)start of the timer, high when the counter matches the comparator
+  config.duty_mode = MCPWM_DUTY_MODE_1;
+
+  // Each timer serves 2 channels
+  for (uint8_t channel = 0; channel < nChannels; channel += 2) {
+    mcpwm_unit_t unit = unitOf(channel);
+    mcpwm_timer_t timer = timerOf(channel);
+    mcpwm_init(unit, timer, &config);
+
+#if defined(ESP_IDF_VERSION_MAJOR) && (ESP_IDF_VERSION_MAJOR > 4 || (ESP_IDF_VERSION_MAJOR == 4 && ESP_IDF_VERSION_MINOR >= 4))
+    mcpwm_sync_config_t syncConfig;
+    syncConfig.sync_sig = MCPWM_SELECT_GPIO_SYNC0;
+    syncConfig.timer_val = 0;
+    syncConfig.count_direction = MCPWM_TIMER_DIRECTION_UP;
+    mcpwm_sync_configure(unit, timer, &syncConfig);
+#else
+    mcpwm_sync_enable(unit, timer, MCPWM_SELECT_SYNC0, 0);
+#endif
+  }
+
+  return 1000000 / config.frequency;
+}
+
+uint16_t mcpwmGatesSetPeriod(uint8_t nChannels, uint16_t maxPeriod) {
+  uint32_t frequency = periodToFrequency(maxPeriod);
+  for (uint8_t channel = 0; channel < nChannels; channel += 2) {
+    mcpwm_set_frequency(unitOf(channel), timerOf(channel), frequency);
+  }
+  return 1000000 / frequency;
+}
+
+void mcpwmGatesSetDelay(uint8_t channel, uint16_t delay) {
+  mcpwm_set_duty_in_us(unitOf(channel), timerOf(channel), generatorOf(channel), delay);
+  // Restore the PWM output, in case it was forced by mcpwmGatesOn/Off(..)
+  mcpwm_set_duty_type(unitOf(channel), timerOf(channel), generatorOf(channel), MCPWM_DUTY_MODE_1);
+}
+
+void mcpwmGatesOn(uint8_t channel) {
+  mcpwm_set_signal_high(unitOf(channel), timerOf(channel), generatorOf(channel));
+}
+
+void mcpwmGatesOff(uint8_t channel) {
+  mcpwm_set_signal_low(unitOf(channel), timerOf(channel), generatorOf(channel));
+}
+
+#endif  // END ESP32_MCPWM_GATES
@@ -0,0 +1,72 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+/***********************************************************************************
+ * Optional ESP32 backend generating the gate signals with the MCPWM peripheral.
+ * Every thyristor is bound to a generator (2 units x 3 timers x 2 generators = 12
+ * channels). The zero cross signal is routed to the sync input of all the timers,
+ * which restart counting at each zero cross: the generator output goes high when
+ * the counter matches the activation delay, and low when the timer restarts. Hence
+ * gates are driven without any CPU interrupt.
+ ***********************************************************************************/
+#ifndef HW_MCPWM_ESP32_H
+#define HW_MCPWM_ESP32_H
+
+#include <stdint.h>
+
+/**
+ * Maximum number of gates driven by MCPWM.
+ */
+static const uint8_t MCPWM_GATES_MAX = 12;
+
+/**
+ * Route the output of the given channel to the given pin.
+ */
+void mcpwmGatesAttach(uint8_t channel, uint8_t pin);
+
+/**
+ * Configure the first *nChannels* channels to restart at each zero cross detected on *syncPin*.
+ * Return the period of the timers in microseconds, i.e. when the gates are turned off,
+ * which is the biggest value not greater than *maxPeriod* allowed by the driver.
+ */
+uint16_t mcpwmGatesBegin(uint8_t syncPin, uint8_t nChannels, uint16_t maxPeriod);
+
+/**
+ * Change the period of the timers, see mcpwmGatesBegin(..).
+ */
+uint16_t mcpwmGatesSetPeriod(uint8_t nChannels, uint16_t maxPeriod);
+
+/**
+ * Turn on the gate at *delay* microseconds after each zero cross.
+ * The new value is applied from the next period.
+ */
+void mcpwmGatesSetDelay(uint8_t channel, uint16_t delay);
+
+/**
+ * Keep the gate always on.
+ */
+void mcpwmGatesOn(uint8_t channel);
+
+/**
+ * Keep the gate always off.
+ */
+void mcpwmGatesOff(uint8_t channel);
+
+#endif  // END HW_MCPWM_ESP32_H
@@ -0,0 +1,141 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+#include "thyristor.h"
+
+#ifdef RP2040_PIO_GATES
+
+#include "hw_pio_pico.h"
+#include <hardware/clocks.h>
+#include <hardware/pio.h>
+
+// Program of each state machine, clocked at 1MHz so every loop iteration lasts 1us. A TX word
+// packs the activation delay (high half-word) and the gate pulse length (low half-word). The
+// last word is kept in X, so it is applied again at each zero cross until a new one is pushed.
+//
+//  0: pull noblock   ; OSR = new word, or X if the FIFO is empty
+//  1: mov x, osr
+//  2: wait 0 pin 0   ; wait for the rising edge of the zero cross signal
+//  3: wait 1 pin 0
+//  4: out y, 16      ; Y = delay
+//  5: jmp y-- 5
+//  6: out y, 16      ; Y = pulse length, 0 keeps the gate off
+//  7: jmp !y 10
+//  8: set pins, 1
+//  9: jmp y-- 9
+// 10: set pins, 0
+static const uint8_t programLength = 11;
+static uint16_t programInstructions[programLength];
+static const pio_program_t program = { programInstructions, programLength, -1 };
+
+// Cycles spent by the program between the edge (including the 2 cycles of the input
+// synchronizer) and the gate activation, and during the pulse besides the loop itself
+static const uint16_t delayLatency = 5;
+static const uint16_t lengthLatency = 2;
+
+static const PIO pios[] = { pio0, pio1 };
+static int8_t programOffset[2] = { -1, -1 };
+
+static uint8_t syncPin;
+static PIO channelPio[PIO_GATES_MAX];
+static int8_t channelSm[PIO_GATES_MAX] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+
+void pioGatesBegin(uint8_t pin) {
+  syncPin = pin;
+
+  programInstructions[0] = pio_encode_pull(false, false);
+  programInstructions[1] = pio_encode_mov(pio_x, pio_osr);
+  programInstructions[2] = pio_encode_wait_pin(false, 0);
+  programInstructions[3] = pio_encode_wait_pin(true, 0);
+  programInstructions[4] = pio_encode_out(pio_y, 16);
+  programInstructions[5] = pio_encode_jmp_y_dec(5);
+  programInstructions[6] = pio_encode_out(pio_y, 16);
+  programInstructions[7] = pio_encode_jmp_not_y(10);
+  programInstructions[8] = pio_encode_set(pio_pins, 1);
+  programInstructions[9] = pio_encode_jmp_y_dec(9);
+  programInstructions[10] = pio_encode_set(pio_pins, 0);
+}
+
+bool pioGatesAttach(uint8_t channel, uint8_t pin) {
+  // Take the first free state machine, loading the program on its PIO block if needed
+  uint8_t p = 0;
+  int sm = -1;
+  while (p < 2 && sm < 0) {
+    sm = pio_claim_unused_sm(pios[p], false);
+    if (sm >= 0 && programOffset[p] < 0) {
+      if (pio_can_add_program(pios[p], &program)) {
+        programOffset[p] = pio_add_program(pios[p], &program);
+      } else {
+        pio_sm_unclaim(pios[p], sm);
+        sm = -1;
+      }
+    }
+    if (sm < 0) { p++; }
+  }
+  if (sm < 0) { return false; }
+
+  PIO pio = pios[p];
+  uint8_t offset = programOffset[p];
+  pio_sm_config config = pio_get_default_sm_config();
+  sm_config_set_wrap(&config, offset, offset + programLength - 1);
+  sm_config_set_in_pins(&config, syncPin);
+  sm_config_set_set_pins(&config, pin, 1);
+  // Shift left, so the delay comes out first
+  sm_config_set_out_shift(&config, false, false, 32);
+  sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_TX);
+  sm_config_set_clkdiv(&config, clock_get_hz(clk_sys) / 1000000.0f);
+
+  pio_gpio_init(pio, pin);
+  pio_sm_set_consistent_pindirs(pio, sm, pin, 1, true);
+  // X starts from 0, i.e. gate off
+  pio_sm_init(pio, sm, offset, &config);
+  pio_sm_set_enabled(pio, sm, true);
+
+  channelPio[channel] = pio;
+  channelSm[channel] = sm;
+  return true;
+}
+
+void pioGatesDetach(uint8_t channel) {
+  if (channelSm[channel] < 0) { return; }
+
+  PIO pio = channelPio[channel];
+  uint8_t sm = channelSm[channel];
+  pio_sm_set_enabled(pio, sm, false);
+  // Leave the gate off, pins keep the last value set by the state machine
+  pio_sm_exec(pio, sm, pio_encode_set(pio_pins, 0));
+  pio_sm_unclaim(pio, sm);
+  channelSm[channel] = -1;
+}
+
+void pioGatesSet(uint8_t channel, uint16_t delay, uint16_t length) {
+  if (channelSm[channel] < 0) { return; }
+
+  delay = delay > delayLatency ? delay - delayLatency : 0;
+  if (length) { length = length > lengthLatency ? length - lengthLatency : 1; }
+
+  PIO pio = channelPio[channel];
+  uint8_t sm = channelSm[channel];
+  // Only the last word matters: drop the ones not consumed yet
+  pio_sm_clear_fifos(pio, sm);
+  pio_sm_put(pio, sm, (uint32_t)delay << 16 | length);
+}
+
+#endif  // END RP2040_PIO_GATES
@@ -0,0 +1,61 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+/***********************************************************************************
+ * Optional RP2040 backend generating the gate signals with PIO state machines, one per
+ * thyristor. Each state machine waits for the zero cross signal, counts the activation
+ * delay and then holds the gate high for the requested time, so the CPU only pushes a
+ * new word when the delay changes.
+ ***********************************************************************************/
+#ifndef HW_PIO_PICO_H
+#define HW_PIO_PICO_H
+
+#include <stdint.h>
+
+/**
+ * Maximum number of gates driven by PIO (2 PIO blocks x 4 state machines).
+ */
+static const uint8_t PIO_GATES_MAX = 8;
+
+/**
+ * Set the pin receiving the zero cross signal (RISING edge), used by the following
+ * pioGatesAttach(..).
+ */
+void pioGatesBegin(uint8_t syncPin);
+
+/**
+ * Claim a state machine for the given channel and start driving the given pin.
+ * Return false if all the state machines are already used (e.g. by other libraries), or if
+ * there is no room for the program.
+ */
+bool pioGatesAttach(uint8_t channel, uint8_t pin);
+
+/**
+ * Stop the state machine of the given channel and release it.
+ */
+void pioGatesDetach(uint8_t channel);
+
+/**
+ * Turn on the gate at *delay* microseconds after each zero cross, for *length* microseconds.
+ * A null *length* keeps the gate off. The new value is applied from the next zero cross.
+ */
+void pioGatesSet(uint8_t channel, uint16_t delay, uint16_t length);
+
+#endif  // END HW_PIO_PICO_H
@@ -0,0 +1,302 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+
+/***********************************************************************************
+ * Timer policy followed by the ISRs. The HAL of each architecture (hw_timer_*.h) is
+ * wrapped into the same set of inlined functions of HwTimer, selected at compile time,
+ * so the ISRs are straight-line code without any #if chain. A new architecture plugs
+ * in here, by providing its own HAL and HwTimer:
+ * - begin(..), to configure the timer, optionally with its interrupt served by the calling
+ *   core (see THYRISTOR_ISR_CORE), and the function called by the alarms;
+ * - alarm_t, the value accepted to arm the timer, and toAlarm(..) to compute it from the time
+ *   point *from* to the time point *at* (both from the zero cross, in microseconds);
+ * - setCallback(..), to change the function called by the next alarms;
+ * - restart(), called at the beginning of the zero cross ISR;
+ * - start(..), to arm the first alarm from the zero cross, and startShifted(..) to anticipate
+ *   (or postpone) it and the following ones (see ZC_PREDICTIVE_FIRING);
+ * - next(..), to arm the following alarm from the callback;
+ * - finish(), called by the callback when no more alarms are armed;
+ * - halt(), to stop the timer until the next start(..).
+ ***********************************************************************************/
+#ifndef HW_TIMER_POLICY_H
+#define HW_TIMER_POLICY_H
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_ESP8266)
+#include "hw_timer_esp8266.h"
+#elif defined(ARDUINO_ARCH_ESP32)
+#include "hw_timer_esp32.h"
+#elif defined(ARDUINO_ARCH_AVR)
+#include "hw_timer_avr.h"
+#elif defined(ARDUINO_ARCH_SAMD)
+#include "hw_timer_samd.h"
+#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+#include "hw_timer_pico.h"
+#else
+#error "only ESP8266, ESP32, AVR, SAMD & RP2040 (non-mbed) architectures are supported"
+#endif
+
+// Called from ISRs, see THYRISTOR_ISR_ATTR in thyristor.cpp
+#define HW_TIMER_INLINE static inline __attribute__((always_inline))
+
+#if defined(ARDUINO_ARCH_ESP8266)
+
+struct HwTimer {
+  // Ticks of the timer, relative to the current time
+  typedef uint32_t alarm_t;
+
+  static void begin(void (*f)(), bool = false) {
+    timer1_attachInterrupt(f);
+    // These 2 registers assignments are the "unrolling" of:
+    // timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+    T1C = (1 << TCTE) | ((TIM_DIV16 & 3) << TCPD) | ((TIM_EDGE & 1) << TCIT) |
+          ((TIM_SINGLE & 1) << TCAR);
+    T1I = 0;
+  }
+
+  static constexpr alarm_t toAlarm(uint16_t from, uint16_t at) {
+    return US_TO_RTC_TIMER_TICKS(at - from);
+  }
+
+  HW_TIMER_INLINE void setCallback(void (*f)()) {
+    timer1_attachInterrupt(f);
+  }
+
+  HW_TIMER_INLINE void restart() {}
+
+  HW_TIMER_INLINE void start(alarm_t alarm) {
+    timer1_write(alarm);
+  }
+
+  HW_TIMER_INLINE void startShifted(uint16_t delay, int16_t shift) {
+    start(toAlarm(0, delay - shift));
+  }
+
+  HW_TIMER_INLINE void next(alarm_t alarm) {
+    timer1_write(alarm);
+  }
+
+  HW_TIMER_INLINE void finish() {
+    // Given the Arduino HAL and esp8266 technical reference manual,
+    // when timer triggers, the counter stops because it has reached zero
+    // and no-autorealod was set (this timer can only down-count).
+  }
+
+  HW_TIMER_INLINE void halt() {
+    // Mask the edge interrupt of the armed count, timer1_write(..) unmasks it
+    TEIE &= ~TEIE1;
+  }
+};
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+struct HwTimer {
+  // Microseconds from the zero cross, the HAL applies the shift of startShifted(..) to
+  // all of them
+  typedef uint32_t alarm_t;
+
+  // The interrupt is allocated on the calling core anyway
+  static void begin(void (*f)(), bool = false) {
+    timerInit(f);
+  }
+
+  static constexpr alarm_t toAlarm(uint16_t, uint16_t at) {
+    return at;
+  }
+
+  HW_TIMER_INLINE void setCallback(void (*f)()) {
+    timerSetCallback(f);
+  }
+
+  HW_TIMER_INLINE void restart() {}
+
+  HW_TIMER_INLINE void start(alarm_t alarm) {
+    startTimerAndTrigger(alarm);
+  }
+
+  HW_TIMER_INLINE void startShifted(uint16_t delay, int16_t shift) {
+    startTimerAndTrigger(toAlarm(0, delay), shift);
+  }
+
+  HW_TIMER_INLINE void next(alarm_t alarm) {
+    setAlarm(alarm);
+  }
+
+  HW_TIMER_INLINE void finish() {
+    stopTimer();
+  }
+
+  HW_TIMER_INLINE void halt() {
+    stopTimer();
+  }
+};
+
+#elif defined(ARDUINO_ARCH_AVR)
+
+struct HwTimer {
+  // Ticks of the timer, relative to the current time or, with AVR_INPUT_CAPTURE, to the captured
+  // zero cross
+  typedef uint16_t alarm_t;
+
+  // With AVR_INPUT_CAPTURE, the timer is configured by timerCaptureBegin(..)
+  static void begin(void (*f)(), bool = false) {
+    timerSetCallback(f);
+#ifndef AVR_INPUT_CAPTURE
+    timerBegin();
+#endif
+  }
+
+  HW_TIMER_INLINE alarm_t toAlarm(uint16_t from, uint16_t at) {
+#ifdef AVR_INPUT_CAPTURE
+    (void)from;
+    return microsecond2Tick(at);
+#else
+    return microsecond2Tick(at - from);
+#endif
+  }
+
+  HW_TIMER_INLINE void setCallback(void (*f)()) {
+    timerSetCallback(f);
+  }
+
+  HW_TIMER_INLINE void restart() {
+#ifdef AVR_INPUT_CAPTURE
+    // The edge has passed the filters: the alarms of this semi-period are relative to it
+    timerCaptureAccept();
+#else
+    // Early timer start. This is necessary since the instructions executed in the zero cross ISR
+    // take much time (more than 30us with only 4 dimmers). Before the end of the ISR, either
+    // the timer is stop or the alarm time is properly set.
+    timerStartAndTrigger(microsecond2Tick(15000));
+#endif
+  }
+
+  HW_TIMER_INLINE void start(alarm_t alarm) {
+    timerSetAlarm(alarm);
+  }
+
+  HW_TIMER_INLINE void startShifted(uint16_t delay, int16_t shift) {
+    start(toAlarm(0, delay - shift));
+  }
+
+  HW_TIMER_INLINE void next(alarm_t alarm) {
+    timerSetAlarm(alarm);
+  }
+
+  HW_TIMER_INLINE void finish() {
+    // Given actual HAL, the compare interrupt is disabled when it triggers
+  }
+
+  HW_TIMER_INLINE void halt() {
+    timerStop();
+  }
+};
+
+#elif defined(ARDUINO_ARCH_SAMD)
+
+struct HwTimer {
+  // Ticks of the timer, relative to the current time
+  typedef uint16_t alarm_t;
+
+  static void begin(void (*f)(), bool = false) {
+    timerSetCallback(f);
+    timerBegin();
+  }
+
+  HW_TIMER_INLINE alarm_t toAlarm(uint16_t from, uint16_t at) {
+    return microsecond2Tick(at - from);
+  }
+
+  HW_TIMER_INLINE void setCallback(void (*f)()) {
+    timerSetCallback(f);
+  }
+
+  HW_TIMER_INLINE void restart() {}
+
+  HW_TIMER_INLINE void start(alarm_t alarm) {
+    timerStart(alarm);
+  }
+
+  HW_TIMER_INLINE void startShifted(uint16_t delay, int16_t shift) {
+    start(toAlarm(0, delay - shift));
+  }
+
+  HW_TIMER_INLINE void next(alarm_t alarm) {
+    timerStart(alarm);
+  }
+
+  HW_TIMER_INLINE void finish() {
+    // Given actual HAL, and SAMD counter automatically stops on interrupt
+  }
+
+  HW_TIMER_INLINE void halt() {
+    timerStop();
+  }
+};
+
+#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+
+struct HwTimer {
+  // Microseconds from the zero cross, taken by restart() and moved by startShifted(..)
+  typedef uint32_t alarm_t;
+
+  static void begin(void (*f)(), bool localCore = false) {
+    timerSetCallback(f);
+    timerBegin(localCore);
+  }
+
+  static constexpr alarm_t toAlarm(uint16_t, uint16_t at) {
+    return at;
+  }
+
+  HW_TIMER_INLINE void setCallback(void (*f)()) {
+    timerSetCallback(f);
+  }
+
+  HW_TIMER_INLINE void restart() {
+    timerRestart();
+  }
+
+  HW_TIMER_INLINE void start(alarm_t alarm) {
+    timerStart(alarm);
+  }
+
+  HW_TIMER_INLINE void startShifted(uint16_t delay, int16_t shift) {
+    timerShift(shift);
+    start(toAlarm(0, delay));
+  }
+
+  HW_TIMER_INLINE void next(alarm_t alarm) {
+    timerStart(alarm);
+  }
+
+  HW_TIMER_INLINE void finish() {
+    // Timer callback is not rescheduled
+  }
+
+  HW_TIMER_INLINE void halt() {
+    timerStop();
+  }
+};
+
+#endif
+
+#endif  // END HW_TIMER_POLICY_H
@@ -19,6 +19,7 @@
  ******************************************************************************/
 #ifdef AVR
 
+#include "thyristor.h"
 #include "hw_timer_avr.h"
 #include <util/atomic.h>
 #include <Arduino.h>
@@ -66,6 +67,30 @@
 #define _TIMER_COMPA_VECTOR(X) TIMER##X##_COMPA_vect
 #define TIMER_COMPA_VECTOR(X)  _TIMER_COMPA_VECTOR(X)
 
+#ifdef AVR_INPUT_CAPTURE
+#if N_BIT_TIMER != 16
+#error "AVR_INPUT_CAPTURE requires a 16-bit timer"
+#endif
+
+#define _TIFRx(X)              TIFR##X
+#define TIFRx(X)               _TIFRx(X)
+#define _OCFxA(X)              OCF##X##A
+#define OCFxA(X)               _OCFxA(X)
+#define _ICFx(X)               ICF##X
+#define ICFx(X)                _ICFx(X)
+#define _ICIEx(X)              ICIE##X
+#define ICIEx(X)               _ICIEx(X)
+#define _ICESx(X)              ICES##X
+#define ICESx(X)               _ICESx(X)
+#define _ICNCx(X)              ICNC##X
+#define ICNCx(X)               _ICNCx(X)
+#define _ICRx(X)               ICR##X
+#define ICRx(X)                _ICRx(X)
+
+#define _TIMER_CAPT_VECTOR(X)  TIMER##X##_CAPT_vect
+#define TIMER_CAPT_VECTOR(X)   _TIMER_CAPT_VECTOR(X)
+#endif
+
 static void (*timer_callback)() = nullptr;
 
 ISR(TIMER_COMPA_VECTOR(TIMER_ID)) {
@@ -75,14 +100,15 @@ ISR(TIMER_COMPA_VECTOR(TIMER_ID)) {
   if (timer_callback != nullptr) { timer_callback(); }
 }
 
-uint16_t microsecond2Tick(uint16_t micro) {
-  // a frequency value to match the conversion in MICROSECONDS
-  static const uint32_t freq = F_CPU / 1000000;
+// a frequency value to match the conversion in MICROSECONDS
+static const uint32_t freq = F_CPU / 1000000;
 #if N_BIT_TIMER == 8
-  static const uint16_t prescaler = 1024;
+static const uint16_t prescaler = 1024;
 #elif N_BIT_TIMER == 16
-  static const uint16_t prescaler = 8;
+static const uint16_t prescaler = 8;
 #endif
+
+uint16_t microsecond2Tick(uint16_t micro) {
   static_assert((((uint32_t)1 << N_BIT_TIMER) - 1) / ((float)F_CPU / prescaler) * 1000000 > 10000,
                 "the timer configuration has to allows to store a time value greater than 10000 "
                 "(microseconds)");
@@ -160,6 +186,7 @@ void timerStartAndTrigger(uint16_t tick) {
   TIMSKx(TIMER_ID) = 1 << OCIExA(TIMER_ID);
 }
 
+#ifndef AVR_INPUT_CAPTURE
 void timerSetAlarm(uint16_t tick) {
 #if N_BIT_TIMER == 8
   OCRxA(TIMER_ID) = tick;
@@ -175,5 +202,72 @@ void timerSetAlarm(uint16_t tick) {
 void timerStop() {
   TCCRxB(TIMER_ID) &= 0b11111000;
 }
+#else
+static void (*capture_callback)() = nullptr;
+// The last captured edge, and the one the alarms are relative to (see timerCaptureAccept())
+static volatile uint16_t edgeTick = 0;
+static volatile uint16_t captureTick = 0;
+static bool captureBothEdges = false;
+
+ISR(TIMER_CAPT_VECTOR(TIMER_ID)) {
+  edgeTick = ICRx(TIMER_ID);
+  // Look for the opposite edge
+  if (captureBothEdges) {
+    TCCRxB(TIMER_ID) ^= 1 << ICESx(TIMER_ID);
+    TIFRx(TIMER_ID) = 1 << ICFx(TIMER_ID);
+  }
+
+  if (capture_callback != nullptr) { capture_callback(); }
+}
+
+uint16_t tick2Microsecond(uint16_t tick) {
+  return (uint32_t)tick * prescaler / freq;
+}
+
+void timerCaptureBegin(void (*f)(), int mode) {
+  capture_callback = f;
+  captureBothEdges = mode == CHANGE;
+
+  TCCRxA(TIMER_ID) = 0;
+  // Normal mode (free running), noise canceler, prescaler 8
+  TCCRxB(TIMER_ID) = (1 << ICNCx(TIMER_ID)) | (mode == FALLING ? 0 : 1 << ICESx(TIMER_ID)) | 0x02;
+}
+
+void timerCaptureEnable() {
+  // Forget the edges latched while disabled
+  TIFRx(TIMER_ID) = 1 << ICFx(TIMER_ID);
+  TIMSKx(TIMER_ID) |= 1 << ICIEx(TIMER_ID);
+}
+
+void timerCaptureDisable() {
+  TIMSKx(TIMER_ID) &= ~(1 << ICIEx(TIMER_ID));
+}
+
+uint16_t timerCaptureTick() {
+  uint16_t tick;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { tick = edgeTick; }
+  return tick;
+}
+
+void timerCaptureAccept() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { captureTick = edgeTick; }
+}
+
+void timerSetAlarm(uint16_t tick) {
+  uint16_t alarm = captureTick + tick;
+  // If the alarm is already passed (e.g. the ISR was delayed), trigger it as soon as possible
+  // instead of waiting for the counter to wrap
+  if ((int16_t)(alarm - TCNTx(TIMER_ID)) < 2) { alarm = TCNTx(TIMER_ID) + 2; }
+  OCRxA(TIMER_ID) = alarm;
+
+  TIFRx(TIMER_ID) = 1 << OCFxA(TIMER_ID);
+  TIMSKx(TIMER_ID) |= 1 << OCIExA(TIMER_ID);
+}
+
+void timerStop() {
+  // The counter keeps running to capture the next edges
+  TIMSKx(TIMER_ID) &= ~(1 << OCIExA(TIMER_ID));
+}
+#endif
 
 #endif  // END AVR
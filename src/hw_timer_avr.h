@@ -59,6 +59,37 @@ void timerSetAlarm(uint16_t tick);
 
 void timerStop();
 
+#ifdef AVR_INPUT_CAPTURE
+/**
+ * Convert tick to microsecond, the inverse of microsecond2Tick(..).
+ */
+uint16_t tick2Microsecond(uint16_t tick);
+
+/**
+ * Configure the timer to run freely and to latch its counter on the edges (RISING, FALLING or
+ * CHANGE) of the input capture pin (ICP1 for timer 1, i.e. D8 on Uno/Nano and D4 on Leonardo).
+ * The callback is called on each captured edge, once enabled by timerCaptureEnable().
+ * In this mode, timerSetAlarm(..) is relative to the last accepted edge (see
+ * timerCaptureAccept()), and it replaces timerStartAndTrigger(..).
+ */
+void timerCaptureBegin(void (*f)(), int mode);
+
+void timerCaptureEnable();
+
+void timerCaptureDisable();
+
+/**
+ * Return the counter value latched by the last captured edge.
+ */
+uint16_t timerCaptureTick();
+
+/**
+ * Make the last captured edge the origin of the following timerSetAlarm(..). Until then, they
+ * stay relative to the previous accepted edge, so a rejected glitch doesn't shift them.
+ */
+void timerCaptureAccept();
+#endif
+
 #endif  // HW_TIMER_ARDUINO_H
 
 #endif  // END AVR
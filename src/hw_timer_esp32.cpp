@@ -25,7 +25,19 @@ const static int TIMER_ID = 0;
 
 static hw_timer_t* timer = nullptr;
 
+// Applied to all the alarms of the current semi-period, see startTimerAndTrigger(..)
+static int32_t alarmShift = 0;
+
+static void (*timer_callback)() = nullptr;
+
+// The interrupt is attached once, since attaching it is not allowed inside an ISR
+static void ARDUINO_ISR_ATTR onAlarm() {
+  timer_callback();
+}
+
 void timerInit(void (*callback)()) {
+  timer_callback = callback;
+
   // Use 1st timer of 4 (counted from zero).
   // Set 80 divider for prescaler (see ESP32 Technical Reference Manual for more
   // info), count up. The counter starts to increase its value.
@@ -33,18 +45,23 @@ void timerInit(void (*callback)()) {
   timerStop(timer);
   timerWrite(timer, 0);
 
-  timerAttachInterrupt(timer, callback, false);
+  timerAttachInterrupt(timer, onAlarm, false);
+}
+
+void ARDUINO_ISR_ATTR timerSetCallback(void (*callback)()) {
+  timer_callback = callback;
 }
 
-void ARDUINO_ISR_ATTR startTimerAndTrigger(uint32_t delay) {
+void ARDUINO_ISR_ATTR startTimerAndTrigger(uint32_t delay, int32_t shift) {
+  alarmShift = shift;
   timerWrite(timer, 0);
-  timerAlarmWrite(timer, delay, false);
+  timerAlarmWrite(timer, delay - alarmShift, false);
   timerAlarmEnable(timer);
   timerStart(timer);
 }
 
 void ARDUINO_ISR_ATTR setAlarm(uint32_t delay) {
-  timerAlarmWrite(timer, delay, false);
+  timerAlarmWrite(timer, delay - alarmShift, false);
 
   // On core v2.0.0-2.0.1, the timer alarm is automatically disabled after triggering,
   // so re-enable the alarm
@@ -27,9 +27,22 @@
 #define ARDUINO_ISR_ATTR
 #endif
 
+/**
+ * Configure the timer, the alarms call *callback* until timerSetCallback(..) changes it.
+ */
 void timerInit(void (*callback)());
 
-void startTimerAndTrigger(uint32_t delay);
+/**
+ * Set the function called by the next alarms.
+ */
+void timerSetCallback(void (*callback)());
+
+/**
+ * Start the timer from the zero cross and arm the first alarm. A positive *shift* anticipates
+ * this alarm and the following ones set by setAlarm() by that many microseconds, a negative one
+ * postpones them.
+ */
+void startTimerAndTrigger(uint32_t delay, int32_t shift = 0);
 
 void setAlarm(uint32_t delay);
 
@@ -26,29 +26,49 @@
 static void (*timer_callback)() = nullptr;
 static alarm_id_t alarm_id;
 static alarm_pool_t *alarm_pool;
+static uint64_t origin;
 
-void timerBegin() {
-  alarm_pool = alarm_pool_get_default();
+void timerBegin(bool dedicatedPool) {
+  if (dedicatedPool) {
+    // The next alarm is added by the callback of the current one, while it still holds its slot
+    alarm_pool = alarm_pool_create_with_unused_hardware_alarm(4);
+  } else {
+    alarm_pool = alarm_pool_get_default();
+  }
 }
 
 void timerSetCallback(void (*callback)()) {
   timer_callback = callback;
 }
 
-void timerStart(uint64_t t) {
-  if (alarm_id) {
-    cancel_alarm(alarm_id);
-    alarm_id = 0;
-  }
+void timerRestart() {
+  origin = time_us_64();
+}
+
+void timerShift(int32_t shift) {
+  origin -= shift;
+}
+
+void timerStart(uint32_t t) {
+  timerStop();
 
-  alarm_id = alarm_pool_add_alarm_in_us(
-    alarm_pool, t,
+  // From the origin rather than the current time, so the latency of each alarm doesn't add up
+  alarm_id = alarm_pool_add_alarm_at(
+    alarm_pool, from_us_since_boot(origin + t),
     [](alarm_id_t, void *) -> int64_t {
-      if (timer_callback != nullptr) { timer_callback(); }
+      // Cleared before the callback, which may arm the next alarm
       alarm_id = 0;
+      if (timer_callback != nullptr) { timer_callback(); }
       return 0;  // Do not reschedule alarm
     },
     NULL, true);
 }
 
+void timerStop() {
+  if (alarm_id) {
+    alarm_pool_cancel_alarm(alarm_pool, alarm_id);
+    alarm_id = 0;
+  }
+}
+
 #endif  // END ARDUINO_ARCH_RP2040
@@ -26,9 +26,10 @@
 #include <stdint.h>
 
 /**
- * Initialize the timer.
+ * Initialize the timer. If *dedicatedPool*, the alarms are served by a new alarm pool, whose
+ * interrupt is enabled on the calling core, instead of the default one.
  */
-void timerBegin();
+void timerBegin(bool dedicatedPool = false);
 
 /**
  * Set callback function on timer triggers
@@ -36,9 +37,25 @@ void timerBegin();
 void timerSetCallback(void (*callback)());
 
 /**
- * Start the timer to trigger after the specified number of microseconds.
+ * Take the current time as origin of the following alarms.
  */
-void timerStart(uint64_t t);
+void timerRestart();
+
+/**
+ * Move the origin of the following alarms *shift* microseconds earlier (later if negative).
+ */
+void timerShift(int32_t shift);
+
+/**
+ * Start the timer to trigger the specified number of microseconds after the origin, see
+ * timerRestart(). It replaces the armed alarm, and it triggers at once if that time has passed.
+ */
+void timerStart(uint32_t t);
+
+/**
+ * Cancel the armed alarm, if any.
+ */
+void timerStop();
 
 #endif  // HW_TIMER_PICO_H
 
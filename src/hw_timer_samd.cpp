@@ -134,4 +134,13 @@ void timerStart(uint16_t t) {
     ;
 }
 
+void timerStop() {
+  TCx(TIMER_ID)->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TCx(TIMER_ID)->COUNT16.STATUS.bit.SYNCBUSY == 1)
+    ;
+
+  TCx(TIMER_ID)->COUNT16.INTFLAG.bit.MC0 = 1;
+  NVIC_ClearPendingIRQ(TCx_IRQn(TIMER_ID));
+}
+
 #endif  // END ARDUINO_ARCH_SAMD
\ No newline at end of file
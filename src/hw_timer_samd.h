@@ -52,6 +52,11 @@ void timerSetCallback(void (*callback)());
  */
 void timerStart(uint16_t tick);
 
+/**
+ * Stop the timer, discarding a pending trigger.
+ */
+void timerStop();
+
 #endif  // HW_TIMER_SAMD_H
 
 #endif  // ARDUINO_ARCH_SAMD
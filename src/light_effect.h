@@ -0,0 +1,200 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+#ifndef LIGHT_EFFECT_H
+#define LIGHT_EFFECT_H
+
+#include <Arduino.h>
+
+/**
+ * Two bytes (little endian) of the time of a keyframe, in milliseconds, see LightEffect.
+ */
+#define LIGHT_EFFECT_TIME(ms) (uint8_t)((ms) & 0xff), (uint8_t)((uint16_t)(ms) >> 8)
+
+/**
+ * Player of effects described by keyframe timelines, for an array of DimmableLight or
+ * DimmableLightLinearized.
+ *
+ * A timeline is an array of uint8_t stored in flash (PROGMEM):
+ * - the number of channels C and the number of keyframes K (both at least 1);
+ * - K keyframes, each one made of the time to reach it from the previous keyframe (see
+ *   LIGHT_EFFECT_TIME(..), the one of the first keyframe is used only when the timeline repeats)
+ *   and the brightness of the C channels (input scale of the lights, 0-MAX_BRIGHTNESS).
+ * The light i follows the channel i % C, so a single channel drives all the lights together.
+ *
+ * E.g. 2 groups of lights fading in opposite directions in 2 seconds, back and forth:
+ *
+ *   const uint8_t seesaw[] PROGMEM = {
+ *     2, 2,
+ *     LIGHT_EFFECT_TIME(2000), 0, 200,
+ *     LIGHT_EFFECT_TIME(2000), 200, 0,
+ *   };
+ *
+ * The brightness between 2 keyframes is never computed here: at each keyframe, all the lights
+ * start fading towards the next one within a single batch update, and the zero cross ISR
+ * interpolates them at each semi-period (see Thyristor::setDelay(..)). Hence update() has to be
+ * called from loop() at least once per keyframe only, and a late call doesn't shift the
+ * following keyframes. With ESP32_MCPWM_GATES and RP2040_PIO_GATES the fades are not available:
+ * the lights jump from a keyframe to the next one.
+ */
+template<class Light>
+class LightEffect {
+public:
+  /**
+   * The effect drives the *nLights* lights of the array *lights*.
+   */
+  LightEffect(Light* lights, uint8_t nLights)
+    : lights(lights), nLights(nLights), timeline(nullptr), frame(0), frameTime(0), nextTime(0),
+      repeat(false) {}
+
+  /**
+   * Start playing *timeline* from its first keyframe. If *repeat* is true, it starts again from
+   * the first keyframe after the last one, until stop().
+   */
+  void play(const uint8_t* newTimeline, bool repeatTimeline = true) {
+    timeline = newTimeline;
+    repeat = repeatTimeline;
+    frame = 0;
+    frameTime = millis();
+    applyFrame(0, 0);
+    startSegment(0);
+  }
+
+  /**
+   * Stop the effect, leaving the lights as they are (they may still be fading).
+   */
+  void stop() {
+    timeline = nullptr;
+  }
+
+  /**
+   * Return true while the effect is playing.
+   */
+  bool isPlaying() const {
+    return timeline != nullptr;
+  }
+
+  /**
+   * Move to the next keyframe when due. Between keyframes it costs just a comparison.
+   */
+  void update() {
+    if (timeline == nullptr) { return; }
+    uint32_t elapsed = millis() - frameTime;
+    if (elapsed < nextTime) { return; }
+
+    // Catch up with all the keyframes reached meanwhile (at most a whole timeline)
+    uint8_t keyframes = pgm_read_byte(&timeline[1]);
+    uint8_t reached = 0;
+    while (reached < keyframes && elapsed >= nextTime) {
+      frameTime += nextTime;
+      elapsed -= nextTime;
+      frame = nextFrame();
+      reached++;
+      if (isLast()) {
+        // Where the last fade ended, unless some keyframes have been skipped
+        applyFrame(frame, 0);
+        timeline = nullptr;
+        return;
+      }
+      nextTime = getTime(nextFrame());
+    }
+    // The fade ended on an earlier keyframe: jump to the current one (e.g. after a null time)
+    if (reached > 1) { applyFrame(frame, 0); }
+    startSegment(elapsed);
+  }
+
+private:
+  Light* lights;
+  uint8_t nLights;
+
+  /**
+   * Timeline in flash, nullptr if stopped.
+   */
+  const uint8_t* timeline;
+
+  /**
+   * The last keyframe reached, when it was reached (in milliseconds) and the time from it to the
+   * next one.
+   */
+  uint8_t frame;
+  uint32_t frameTime;
+  uint16_t nextTime;
+
+  bool repeat;
+
+  /**
+   * Return the index of the keyframe following the current one.
+   */
+  uint8_t nextFrame() const {
+    uint8_t next = frame + 1;
+    return next == pgm_read_byte(&timeline[1]) ? 0 : next;
+  }
+
+  /**
+   * Return the address of a keyframe.
+   */
+  const uint8_t* getFrame(uint8_t index) const {
+    uint8_t channels = pgm_read_byte(&timeline[0]);
+    return timeline + 2 + (uint16_t)index * (2 + channels);
+  }
+
+  /**
+   * Return the time to reach a keyframe from the previous one.
+   */
+  uint16_t getTime(uint8_t index) const {
+    const uint8_t* f = getFrame(index);
+    return pgm_read_byte(&f[0]) | (uint16_t)pgm_read_byte(&f[1]) << 8;
+  }
+
+  /**
+   * Return true if the current keyframe is the last one to play.
+   */
+  bool isLast() const {
+    uint8_t keyframes = pgm_read_byte(&timeline[1]);
+    return keyframes == 1 || (!repeat && frame + 1 == keyframes);
+  }
+
+  /**
+   * Start fading all the lights from the current keyframe, reached *elapsed* milliseconds ago,
+   * to the next one. The effect stops if there is no next one.
+   */
+  void startSegment(uint32_t elapsed) {
+    if (isLast()) {
+      timeline = nullptr;
+      return;
+    }
+    nextTime = getTime(nextFrame());
+    applyFrame(nextFrame(), elapsed < nextTime ? nextTime - elapsed : 0);
+  }
+
+  /**
+   * Set the brightness of a keyframe to all the lights within a single batch update.
+   */
+  void applyFrame(uint8_t index, uint16_t fadeTime) {
+    uint8_t channels = pgm_read_byte(&timeline[0]);
+    const uint8_t* values = getFrame(index) + 2;
+    Light::beginUpdate();
+    for (uint8_t i = 0; i < nLights; i++) {
+      lights[i].setBrightness(pgm_read_byte(&values[i % channels]), fadeTime);
+    }
+    Light::commitUpdate();
+  }
+};
+
+#endif  // END LIGHT_EFFECT_H
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+#include "power_curve.h"
+
+uint16_t PowerCurve::getPhase(const uint16_t* curve, uint8_t bri) {
+  uint16_t n = pgm_read_word(&curve[0]);
+  const uint16_t* points = curve + 1;
+
+  // Position along the curve: the segment and the offset into it (in 1/255 of segment)
+  uint16_t position = (uint16_t)bri * (n - 1);
+  uint16_t segment = position / 255;
+  uint8_t offset = position % 255;
+  uint16_t from = pgm_read_word(&points[segment]);
+  if (offset == 0) { return from; }
+  int32_t change = (int32_t)pgm_read_word(&points[segment + 1]) - from;
+
+  // 1/255 to 1/256, so the interpolation is a shift
+  uint8_t weight = ((uint16_t)offset * 257 + 128) >> 8;
+  return from + ((change * weight + 128) >> 8);
+}
+
+// Tables generated by sampling at 65 evenly spaced brightness b in [0;1]:
+// - incandescent: the 50Hz polynomial of DimmableLightLinearized (at hardware brightness 255*b),
+//   divided by the semi-period;
+// - resistive: the firing angle a where the delivered power 1 - a/pi + sin(2a)/(2pi) equals b;
+// - led: the same for the relative luminance of the CIE 1931 lightness L* = 100*b.
+// The phases are a/pi in Q16, rounded to nearest.
+const uint16_t PowerCurve::incandescent[] PROGMEM = {
+  65, 65434, 61782, 58605, 55852, 53474, 51427, 49671, 48166, 46877,
+  45774, 44827, 44009, 43297, 42670, 42108, 41595, 41116, 40660, 40215,
+  39772, 39325, 38868, 38396, 37908, 37400, 36874, 36328, 35764, 35184,
+  34591, 33987, 33376, 32761, 32146, 31534, 30930, 30337, 29757, 29192,
+  28646, 28118, 27610, 27121, 26649, 26191, 25743, 25299, 24853, 24395,
+  23915, 23401, 22838, 22209, 21495, 20676, 19727, 18622, 17333, 15826,
+  14067, 12019, 9639, 6884, 3705, 51
+};
+
+const uint16_t PowerCurve::resistive[] PROGMEM = {
+  65, 65535, 56686, 54304, 52597, 51212, 50021, 48963, 48000, 47112,
+  46281, 45498, 44754, 44043, 43360, 42701, 42063, 41442, 40838, 40248,
+  39670, 39103, 38545, 37996, 37453, 36918, 36388, 35862, 35340, 34822,
+  34306, 33792, 33280, 32768, 32255, 31743, 31229, 30713, 30195, 29673,
+  29147, 28617, 28082, 27539, 26990, 26432, 25865, 25287, 24697, 24093,
+  23472, 22834, 22175, 21492, 20781, 20037, 19254, 18423, 17535, 16572,
+  15514, 14323, 12938, 11231, 8849, 0
+};
+
+const uint16_t PowerCurve::led[] PROGMEM = {
+  65, 65535, 61325, 60223, 59446, 58825, 58298, 57814, 57329, 56842,
+  56353, 55862, 55369, 54874, 54376, 53875, 53372, 52865, 52356, 51843,
+  51327, 50807, 50283, 49755, 49223, 48686, 48144, 47597, 47045, 46487,
+  45923, 45353, 44776, 44191, 43599, 42999, 42391, 41773, 41145, 40507,
+  39857, 39196, 38521, 37833, 37129, 36409, 35671, 34914, 34135, 33332,
+  32503, 31644, 30753, 29824, 28852, 27830, 26750, 25601, 24366, 23026,
+  21547, 19882, 17942, 15552, 12225, 0
+};
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+#ifndef POWER_CURVE_H
+#define POWER_CURVE_H
+
+#include <Arduino.h>
+
+/**
+ * Curves mapping the hardware brightness (0-255) to the activation delay of a load, as fraction
+ * of the semi-period (Q16, see Thyristor::setPhase(..)): the same curve suits both 50Hz and 60Hz.
+ *
+ * A curve is an array of uint16_t stored in flash (PROGMEM): the number of points n (2 <= n <=
+ * 256), then the n phases sampled at evenly spaced brightness, the first one at 0 and the last
+ * one at 255. The phases between them are linearly interpolated in fixed point, without any
+ * float math. A curve can be shared by any number of lights, at no RAM cost.
+ *
+ * E.g. a user curve with 5 points:
+ *
+ *   const uint16_t myCurve[] PROGMEM = {5, 65535, 49152, 32768, 16384, 0};
+ */
+class PowerCurve {
+public:
+  /**
+   * Incandescent bulbs and halogen lamps (also through a transformer): the same polynomial fit
+   * of DimmableLightLinearized, with 65 points.
+   */
+  static const uint16_t incandescent[];
+
+  /**
+   * Resistive loads (e.g. heaters): the delivered power is proportional to the brightness.
+   * 65 points.
+   */
+  static const uint16_t resistive[];
+
+  /**
+   * Dimmable LED drivers following the RMS power: the perceived brightness (CIE 1931 lightness)
+   * is proportional to the brightness. Most drivers don't light up below a minimum power, raise
+   * the minimum brightness of the light accordingly. 65 points.
+   */
+  static const uint16_t led[];
+
+  /**
+   * Return the phase of *curve* at the hardware brightness *bri*.
+   */
+  static uint16_t getPhase(const uint16_t* curve, uint8_t bri);
+
+  /**
+   * Return the activation delay (in microseconds) of *curve* at the hardware brightness *bri*,
+   * given the semi-period length.
+   */
+  static uint16_t getDelay(const uint16_t* curve, uint8_t bri, uint16_t semiPeriod) {
+    return ((uint32_t)getPhase(curve, bri) * semiPeriod + 0x8000) >> 16;
+  }
+};
+
+#endif  // END POWER_CURVE_H
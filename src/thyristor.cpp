@@ -18,26 +18,42 @@
  *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
  ******************************************************************************/
 #include "thyristor.h"
-#include "circular_queue.h"
+#include "fast_gpio.h"
+#include "zero_cross_tracker.h"
+#include "hw_timer.h"
 #include <Arduino.h>
 
+#if defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+#include <pico/critical_section.h>
+#include <hardware/sync.h>
+#elif defined(ARDUINO_ARCH_AVR)
+#include <avr/sleep.h>
+#endif
+
+#if defined(ESP32_MCPWM_GATES)
+#include "hw_mcpwm_esp32.h"
+#elif defined(RP2040_PIO_GATES)
+#include "hw_pio_pico.h"
+#endif
+
+// Attribute of the functions called by the ISRs besides the ISRs themselves, they must be placed
+// in IRAM on ESPs. For the same reason the helpers of the headers called by the ISRs (fast_gpio.h,
+// hw_timer.h, zero_cross_tracker.h) are always inlined: a call would jump into flash.
 #if defined(ARDUINO_ARCH_ESP8266)
-#include "hw_timer_esp8266.h"
+#define THYRISTOR_ISR_ATTR HW_TIMER_IRAM_ATTR
 #elif defined(ARDUINO_ARCH_ESP32)
-#include "hw_timer_esp32.h"
-#elif defined(ARDUINO_ARCH_AVR)
-#include "hw_timer_avr.h"
-#elif defined(ARDUINO_ARCH_SAMD)
-#include "hw_timer_samd.h"
-#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
-#include "hw_timer_pico.h"
+#define THYRISTOR_ISR_ATTR ARDUINO_ISR_ATTR
 #else
-#error "only ESP8266, ESP32, AVR, SAMD & RP2040 (non-mbed) architectures are supported"
+#define THYRISTOR_ISR_ATTR
+#endif
+
+// Gates are driven by a peripheral synchronized by the zero cross signal, not by the ISRs
+#if defined(ESP32_MCPWM_GATES) || defined(RP2040_PIO_GATES)
+#define PERIPHERAL_GATES
 #endif
 
-// Ignore zero-cross interrupts when they occurs too early w.r.t semi-period ideal length.
-// The constant *semiPeriodShrinkMargin* defines the "too early" margin.
-// This filter affects the MONITOR_FREQUENCY measurement.
+// Ignore zero-cross interrupts when they occurs too early w.r.t. the zero cross predicted by the
+// tracker (see zero_cross_tracker.h), the tolerance adapts to the measured jitter.
 //#define FILTER_INT_PERIOD
 
 // FOR DEBUG PURPOSE ONLY. This option requires FILTER_INT_PERIOD enabled.
@@ -45,6 +61,31 @@
 // length is exceed the interval defined by *semiPeriodShrinkMargin* and *semiPeriodExpandMargin*.
 //#define PRINT_INT_PERIOD
 
+// Schedule the activations from the predicted zero cross instead of the detected one, so the
+// jitter of the zero cross circuitry (and of the interrupt latency) doesn't shift the firing.
+// The correction is bounded by *maxPredictionShift*. This option enables FILTER_INT_PERIOD.
+//#define ZC_PREDICTIVE_FIRING
+
+#ifdef ZC_PREDICTIVE_FIRING
+#if defined(AVR_INPUT_CAPTURE) || defined(PERIPHERAL_GATES)
+#error "ZC_PREDICTIVE_FIRING requires the gates driven by the timer interrupts"
+#endif
+#ifndef FILTER_INT_PERIOD
+#define FILTER_INT_PERIOD
+#endif
+#endif
+
+// The zero cross signal is tracked to filter it or to measure its frequency
+#if defined(FILTER_INT_PERIOD) || defined(MONITOR_FREQUENCY)
+#define TRACK_ZERO_CROSS
+#endif
+
+// The semi-period follows the detected frequency until it is explicitly set by setFrequency().
+// Peripheral gates are reloaded only by the main thread, so they are excluded.
+#if defined(NETWORK_FREQ_RUNTIME) && defined(MONITOR_FREQUENCY) && !defined(PERIPHERAL_GATES)
+#define AUTO_SEMI_PERIOD
+#endif
+
 // FOR DEBUG PURPOSE ONLY.
 // Prints a char on the serial port if not all thyristors are managed in a semi-period.
 //#define CHECK_MANAGED_THYR
@@ -54,6 +95,73 @@
 // Look at gateTurnOffTime constant for more info.
 //#define PREDEFINED_PULSE_LENGTH
 
+// CPU fallback of PREDEFINED_PULSE_LENGTH: the gates are turned on for *pulseWidth*, but without
+// waiting inside the ISRs. It is not a hardware offload: the gates are turned off by the next
+// activation group far enough from them, and by one more timer event after the last group, which
+// replaces turn_off_gates_int. So the timer interrupts are as many as by default, only the gate
+// current is reduced. The pulse may last longer than *pulseWidth* (when the next group is closer
+// than that), but never less. The pulses timed in hardware are those of RP2040_PIO_GATES.
+//#define SHORT_PULSE_GATES
+
+#ifdef SHORT_PULSE_GATES
+#ifdef PREDEFINED_PULSE_LENGTH
+#error "SHORT_PULSE_GATES and PREDEFINED_PULSE_LENGTH are alternatives"
+#endif
+#ifdef ESP32_MCPWM_GATES
+#error "SHORT_PULSE_GATES is not available with ESP32_MCPWM_GATES, all comparators are in use"
+#endif
+#ifdef THREE_PHASE_ZONES
+#error "SHORT_PULSE_GATES is not available with THREE_PHASE_ZONES"
+#endif
+#endif
+
+#if THYRISTOR_LOG_LEVEL > 1
+// Entries of the trace ring buffer, see THYRISTOR_LOG_LEVEL
+#ifndef THYRISTOR_TRACE_SIZE
+#define THYRISTOR_TRACE_SIZE 32
+#endif
+
+/**
+ * A message stored by the main thread, printed later by Thyristor::printTrace().
+ */
+struct TraceEntry {
+  const __FlashStringHelper *message;
+  int32_t value;
+};
+
+static const int32_t TRACE_NO_VALUE = INT32_MIN;
+
+static TraceEntry traceBuffer[THYRISTOR_TRACE_SIZE];
+static uint8_t traceHead = 0;
+static uint8_t traceCount = 0;
+static uint16_t traceLost = 0;
+
+static void traceWrite(const __FlashStringHelper *message, int32_t value) {
+  uint8_t i = (traceHead + traceCount) % THYRISTOR_TRACE_SIZE;
+  if (traceCount < THYRISTOR_TRACE_SIZE) {
+    traceCount++;
+  } else {
+    // Overwrite the oldest one
+    traceHead = (traceHead + 1) % THYRISTOR_TRACE_SIZE;
+    traceLost++;
+  }
+  traceBuffer[i].message = message;
+  traceBuffer[i].value = value;
+}
+#endif
+
+#if THYRISTOR_LOG_LEVEL > 1
+#define TRACE_DEBUG(message, value) traceWrite(F(message), value)
+#else
+#define TRACE_DEBUG(message, value) ((void)0)
+#endif
+
+#if THYRISTOR_LOG_LEVEL > 2
+#define TRACE_INFO(message, value) traceWrite(F(message), value)
+#else
+#define TRACE_INFO(message, value) ((void)0)
+#endif
+
 // In microseconds
 #ifdef NETWORK_FREQ_FIXED_50HZ
 static const uint16_t semiPeriodLength = 10000;
@@ -63,6 +171,24 @@ static const uint16_t semiPeriodLength = 8333;
 #endif
 #ifdef NETWORK_FREQ_RUNTIME
 static uint16_t semiPeriodLength = 0;
+
+/**
+ * Convert a delay into a fraction of the semi-period (Q16), saturated to UINT16_MAX. While the
+ * semi-period is unknown, only 0 (fully ON) is kept, any other delay turns fully OFF.
+ */
+static uint16_t THYRISTOR_ISR_ATTR toPhase(uint16_t delay, uint16_t semiPeriod) {
+  if (semiPeriod == 0) { return delay > 0 ? UINT16_MAX : 0; }
+  uint32_t phase = ((uint32_t)delay << 16) / semiPeriod;
+  return phase > UINT16_MAX ? UINT16_MAX : phase;
+}
+
+/**
+ * Convert a fraction of the semi-period (Q16) into a delay. Rounding to nearest, UINT16_MAX
+ * gives back the whole semi-period.
+ */
+static uint16_t THYRISTOR_ISR_ATTR fromPhase(uint16_t phase, uint16_t semiPeriod) {
+  return ((uint32_t)phase * semiPeriod + 0x8000) >> 16;
+}
 #endif
 
 // These margins are precautions against noise, electrical spikes and frequency skew errors.
@@ -73,6 +199,25 @@ static uint16_t semiPeriodLength = 0;
 static const uint16_t startMargin = 200;
 static const uint16_t endMargin = 500;
 
+// Rough cost model of the ISRs, usually measured by toggling a spare pin at the ISR entry/exit
+// and watching it with a scope. *isrEntryCost* is the fixed cost of a timer interrupt (context
+// save/restore, timer re-arm), while *isrThyristorCost* is the additional cost of each thyristor
+// managed in the same ISR (gate write, loop and schedule bookkeeping). Values in microseconds.
+// Both can be given in the build flags, e.g. as measured on the actual setup.
+#if defined(THYRISTOR_ISR_ENTRY_COST) && defined(THYRISTOR_ISR_THYRISTOR_COST)
+static const uint16_t isrEntryCost = THYRISTOR_ISR_ENTRY_COST;
+static const uint16_t isrThyristorCost = THYRISTOR_ISR_THYRISTOR_COST;
+#elif defined(ARDUINO_ARCH_AVR)
+static const uint16_t isrEntryCost = 20;
+static const uint16_t isrThyristorCost = 2;
+#elif defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_SAMD)
+static const uint16_t isrEntryCost = 12;
+static const uint16_t isrThyristorCost = 1;
+#else
+static const uint16_t isrEntryCost = 10;
+static const uint16_t isrThyristorCost = 1;
+#endif
+
 // Merge Period represents the time span in which 2 (or more) very near delays are merged (the
 // higher ones are merged in the smaller one). This could be necessary for 2 main reasons:
 // 1) Efficiency, in fact in some applications you will never seem differences between
@@ -83,16 +228,13 @@ static const uint16_t endMargin = 500;
 // value, check the documentation of the specific MCU since some have limitations. For example,
 // ESP8266 API documentation suggests to set timer dealy higher than >10us. If you use 8-bit timers
 // on AVR, you should set a bigger Merge Period (e.g. 100us). Moreover, you should also consider the
-// number of instantiated dimmers: ISRs will take more time as the dimmer count increases, so you
-// may need to increase Merge Period. The default value is intended to handle up to 8 dimmers.
-#if defined(ARDUINO_ARCH_AVR)
-//  This longer Merge Period is due to the implementation of digitalWrite(..) on AVR core, which is
-//  slower than others. In particular, on Arduino Uno R3 and Arduino Mega it takes,
-//  respectively, about 5us and 6us to execute.
-static const uint16_t mergePeriod = 20 + Thyristor::N * 6;
-#else
-static const uint16_t mergePeriod = 20;
-#endif
+// number of instantiated dimmers: in the worst case an ISR manages all of them before arming the
+// next alarm, hence Merge Period grows with the ISR cost model and Thyristor::N.
+static constexpr uint16_t computeMergePeriod(uint16_t isrWorstCost) {
+  return isrWorstCost > 20 ? isrWorstCost : 20;
+}
+static const uint16_t mergePeriod =
+  computeMergePeriod(isrEntryCost + Thyristor::N * isrThyristorCost);
 
 // Period in microseconds before the end of the semiperiod when an interrupt is triggered to
 // turn off all gate signals. This parameter doesn't have any effect if you enable
@@ -102,31 +244,395 @@ static const uint16_t gateTurnOffTime = 300;
 static_assert(endMargin - gateTurnOffTime > mergePeriod, "endMargin must be greater than "
                                                          "(gateTurnOffTime + mergePeriod)");
 
-#ifdef PREDEFINED_PULSE_LENGTH
+static_assert(Thyristor::N > 0 && Thyristor::N < 255, "THYRISTOR_MAX_NUMBER must be in [1;254]");
+
+// In the worst case every thyristor has its own activation, each one at least mergePeriod apart
+// from the previous one: the whole chain must fit in the controllable part of the shortest
+// supported semi-period (60Hz).
+static_assert((uint32_t)Thyristor::N * mergePeriod <= 8333 - startMargin - endMargin,
+              "the activation chain doesn't fit in a semi-period, reduce THYRISTOR_MAX_NUMBER");
+
+#ifdef THREE_PHASE_ZONES
+// Each zone adds an event to turn off its gates. Since the events of the lagging zones wrap around
+// the semi-period, the chain is kept mergePeriod away from both the zero crosses.
+static const uint8_t maxGroups = Thyristor::N + Thyristor::ZONES;
+static_assert((uint32_t)maxGroups * mergePeriod <= 8333 - 2 * mergePeriod,
+              "the activation chain doesn't fit in a semi-period, reduce THYRISTOR_MAX_NUMBER");
+#elif defined(SHORT_PULSE_GATES)
+// One more group after the last activation turns off the gates
+static const uint8_t maxGroups = Thyristor::N + 1;
+static_assert((uint32_t)maxGroups * mergePeriod <= 8333 - startMargin - endMargin,
+              "the activation chain doesn't fit in a semi-period, reduce THYRISTOR_MAX_NUMBER");
+#else
+static const uint8_t maxGroups = Thyristor::N;
+#endif
+
+// Any set of gates grouped by port needs at most this number of entries
+static const uint8_t gatePorts = Thyristor::N < GPIO_PORTS ? Thyristor::N : GPIO_PORTS;
+
+// The merge period actually used follows the slowest recent activation ISR, instead of the cost
+// model (see Thyristor::compileBackSchedule()). On AVR the only clock is micros(), too slow to be
+// read twice per activation, so the cost model is kept unless THYRISTOR_STATS reads it anyway.
+#if !defined(ARDUINO_ARCH_AVR) || defined(THYRISTOR_STATS)
+#define ADAPTIVE_MERGE_WINDOW
+#endif
+
+#ifdef ADAPTIVE_MERGE_WINDOW
+// It is capped to still fit the chain in the semi-period, and to leave the turn off of the gates
+// mergePeriod apart from the last group.
+static const uint16_t maxMergePeriod =
+  (8333 - startMargin - endMargin) / (maxGroups + 2) < endMargin - gateTurnOffTime - 1
+    ? (8333 - startMargin - endMargin) / (maxGroups + 2)
+    : endMargin - gateTurnOffTime - 1;
+static uint16_t mergeWindow = mergePeriod;
+#else
+static const uint16_t mergeWindow = mergePeriod;
+#endif
+
+#if defined(PREDEFINED_PULSE_LENGTH) || defined(THREE_PHASE_ZONES) || defined(SHORT_PULSE_GATES)
+// No timer interrupt after the last activation group: the gates are turned off right after the
+// pulse, by the events of the zones, or by the group closing the pulses
+#define NO_TRAILING_TURN_OFF
+#endif
+
+#if defined(PREDEFINED_PULSE_LENGTH) || defined(SHORT_PULSE_GATES)
 // Length of pulse on thyristor's gate pin. This parameter is not applied if thyristor is fully on
-// or off. This option is suitable only for very short pulses, since it blocks the ISR for the
-// specified amount of time.
+// or off. With PREDEFINED_PULSE_LENGTH, this option is suitable only for very short pulses, since
+// it blocks the ISR for the specified amount of time.
 static uint8_t pulseWidth = 15;
 #endif
 
+#ifdef PERIPHERAL_GATES
+/**
+ * Channels already bound to a thyristor, one bit per channel.
+ */
+static uint16_t usedGateChannels = 0;
+
+/**
+ * True once the peripheral is configured by Thyristor::begin().
+ */
+static bool gatesStarted = false;
+
+// Gates are turned off *gateTurnOffTime* before the end of the semi-period. While the
+// semi-period is unknown (runtime frequency not set yet), fall back to 50Hz.
+static uint16_t gateOffTime() {
+  return (semiPeriodLength ? semiPeriodLength : 10000) - gateTurnOffTime;
+}
+#endif
+
+#if defined(ESP32_MCPWM_GATES)
+static_assert(Thyristor::N <= MCPWM_GATES_MAX, "MCPWM can drive at most 12 thyristors");
+
+/**
+ * Actual period of the MCPWM timers, they restart at each zero cross and they turn off the
+ * gates when they wrap.
+ */
+static uint16_t mcpwmPeriod = 0;
+
+static bool gateAttach(uint8_t channel, uint8_t pin) {
+  mcpwmGatesAttach(channel, pin);
+  return true;
+}
+
+static void gateDetach(uint8_t channel) {
+  mcpwmGatesOff(channel);
+}
+
+// Delays falling after the wrap of the timers would fire again before the next zero cross, so
+// they are considered fully on as well
+static uint16_t gateMinDelay() {
+  uint16_t minDelay = semiPeriodLength - mcpwmPeriod + mergePeriod;
+  return minDelay > startMargin ? minDelay : startMargin;
+}
+
+static void gateOn(uint8_t channel) {
+  mcpwmGatesOn(channel);
+}
+
+static void gateOff(uint8_t channel) {
+  mcpwmGatesOff(channel);
+}
+
+static void gateSetDelay(uint8_t channel, uint16_t delay) {
+  mcpwmGatesSetDelay(channel, delay);
+}
+#elif defined(RP2040_PIO_GATES)
+static_assert(Thyristor::N <= PIO_GATES_MAX, "PIO can drive at most 8 thyristors");
+
+static bool gateAttach(uint8_t channel, uint8_t pin) {
+  return pioGatesAttach(channel, pin);
+}
+
+static void gateDetach(uint8_t channel) {
+  pioGatesDetach(channel);
+}
+
+static uint16_t gateMinDelay() {
+  return startMargin;
+}
+
+static void gateOn(uint8_t channel) {
+  pioGatesSet(channel, 0, gateOffTime());
+}
+
+static void gateOff(uint8_t channel) {
+  pioGatesSet(channel, 0, 0);
+}
+
+static void gateSetDelay(uint8_t channel, uint16_t delay) {
+#ifdef SHORT_PULSE_GATES
+  pioGatesSet(channel, delay, pulseWidth);
+#else
+  pioGatesSet(channel, delay, gateOffTime() - delay);
+#endif
+}
+#endif
+
 struct PinDelay {
-  uint8_t pin;
+  GpioPortMask gate;
   uint16_t delay;
+#ifdef THREE_PHASE_ZONES
+  uint8_t zone;
+  // Turn off the gates of the zone instead of activating a gate
+  bool turnOff;
+#endif
+#ifdef THYRISTOR_STATS
+  // Position in Thyristor::thyristors, and activation time before merging
+  uint8_t index;
+  uint16_t requested;
+#endif
 };
 
-enum class INT_TYPE { ACTIVATE_THYRISTORS, TURN_OFF_GATES };
+// Value accepted by the platform timer to arm the next alarm (ticks or microseconds)
+typedef HwTimer::alarm_t alarm_t;
+
+/**
+ * Thyristors activated together by the same timer interrupt.
+ */
+struct ActivationGroup {
+  /**
+   * Value to arm the timer for the following event, either the next group or the turn off of
+   * the gates.
+   */
+  alarm_t nextAlarm;
+
+  /**
+   * Gates of this group, i.e. Schedule::groupGates[firstGate;gatesEnd).
+   */
+  uint8_t firstGate;
+  uint8_t gatesEnd;
+
+#ifdef SHORT_PULSE_GATES
+  /**
+   * Gates whose pulse is over, turned off before activating this group, i.e.
+   * Schedule::pulseOffGates[firstPulseOff;pulseOffEnd).
+   */
+  uint8_t firstPulseOff;
+  uint8_t pulseOffEnd;
+#endif
 
-static INT_TYPE nextISR = INT_TYPE::ACTIVATE_THYRISTORS;
+#ifdef THREE_PHASE_ZONES
+  /**
+   * Zones (one bit each) whose gates must be turned off, just before their zero cross.
+   */
+  uint8_t turnOffZones;
+#endif
+
+#ifdef THYRISTOR_STATS
+  /**
+   * Scheduled activation time, to measure the firing error.
+   */
+  uint16_t delay;
+#endif
+};
+
+#ifndef PERIPHERAL_GATES
+/**
+ * A thyristor in burst-fire mode. Its accumulator lives in the thyristor, so it survives the
+ * schedule swaps.
+ */
+struct BurstChannel {
+  GpioPortMask gate;
+  Thyristor *thyristor;
+  uint8_t onCycles;
+  uint8_t window;
+};
+#endif
 
 /**
- * Temporary struct manipulated by the ISR storing the timing information about each dimmer.
+ * Everything the ISRs need to drive the thyristors during a semi-period. It is compiled by the
+ * main thread (see Thyristor::updateSchedule()) from the delays already ordered, rounded
+ * accordingly to startMargin/endMargin and merged by mergePeriod, so the ISRs just step through
+ * the activation groups.
  */
-static struct PinDelay pinDelay[Thyristor::N];
+struct Schedule {
+  /**
+   * Gates of all the thyristors grouped by port, so they can be turned off with one store per
+   * port.
+   */
+  GpioPortMask allGates[gatePorts];
+
+  /**
+   * Gates of the thyristors FULLY on, grouped by port.
+   */
+  GpioPortMask alwaysOnGates[gatePorts];
+
+  /**
+   * Gates of the thyristors not always on, grouped by port. These are turned off by
+   * turn_off_gates_int at the end of the semi-period (except the dimmed ones of the lagging
+   * zones, with THREE_PHASE_ZONES).
+   */
+  GpioPortMask dimmedGates[gatePorts];
+
+  /**
+   * Gates of every activation group, grouped by port inside each group.
+   */
+  GpioPortMask groupGates[Thyristor::N];
+
+#ifdef SHORT_PULSE_GATES
+  /**
+   * Gates of every activation group turned off at the end of their pulse, see ActivationGroup.
+   */
+  GpioPortMask pulseOffGates[Thyristor::N];
+#endif
+
+  ActivationGroup groups[maxGroups];
+
+#ifdef THREE_PHASE_ZONES
+  /**
+   * Gates of the dimmed thyristors of each zone, grouped by port.
+   */
+  GpioPortMask zoneGates[Thyristor::ZONES][gatePorts];
+  uint8_t zoneGatesCount[Thyristor::ZONES];
+#endif
+
+#ifndef PERIPHERAL_GATES
+  /**
+   * Burst-fire thyristors, fully driven by the zero cross ISR.
+   */
+  BurstChannel burst[Thyristor::N];
+  uint8_t burstCount;
+#endif
+
+  /**
+   * Value to arm the timer, at the zero cross, for the first activation group.
+   */
+  alarm_t firstAlarm;
+
+#ifdef ZC_PREDICTIVE_FIRING
+  /**
+   * Delay of the first activation group, to arm the timer from the predicted zero cross.
+   */
+  uint16_t firstDelay;
+#endif
+
+  uint8_t allGatesCount;
+  uint8_t alwaysOnGatesCount;
+  uint8_t dimmedGatesCount;
+  uint8_t groupCount;
+
+  /**
+   * True if all the thyristors are either fully on or fully off.
+   */
+  bool allThyristorsOnOff;
+};
 
 /**
- * Summary of thyristors' state used by ISR (concurrent-safe).
+ * Double-buffered schedule: the ISRs follow schedules[frontSchedule], while the main thread
+ * writes the other one. Once it is ready, the zero cross ISR swaps them.
  */
-static bool _allThyristorsOnOff = true;
+static Schedule schedules[2];
+static volatile uint8_t frontSchedule = 0;
+static volatile bool scheduleReady = false;
+
+/**
+ * The schedule followed in the current semi-period, it changes only in zero_cross_int.
+ */
+static const Schedule *activeSchedule = &schedules[0];
+
+// Locks protecting the swap of the schedules. On ESP32 and RP2040 the ISR may be served by the
+// other core, so disabling the interrupts is not enough.
+#if defined(ARDUINO_ARCH_ESP32)
+static portMUX_TYPE scheduleMux = portMUX_INITIALIZER_UNLOCKED;
+#define SCHEDULE_LOCK()       portENTER_CRITICAL(&scheduleMux)
+#define SCHEDULE_UNLOCK()     portEXIT_CRITICAL(&scheduleMux)
+#define SCHEDULE_LOCK_ISR()   portENTER_CRITICAL_ISR(&scheduleMux)
+#define SCHEDULE_UNLOCK_ISR() portEXIT_CRITICAL_ISR(&scheduleMux)
+#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+static critical_section_t scheduleCs;
+#define SCHEDULE_LOCK()       critical_section_enter_blocking(&scheduleCs)
+#define SCHEDULE_UNLOCK()     critical_section_exit(&scheduleCs)
+#define SCHEDULE_LOCK_ISR()   critical_section_enter_blocking(&scheduleCs)
+#define SCHEDULE_UNLOCK_ISR() critical_section_exit(&scheduleCs)
+#else
+#define SCHEDULE_LOCK()       noInterrupts()
+#define SCHEDULE_UNLOCK()     interrupts()
+#define SCHEDULE_LOCK_ISR()
+#define SCHEDULE_UNLOCK_ISR()
+#endif
+
+#ifdef THYRISTOR_COMMAND_QUEUE
+// The posted values are exchanged without locks: each one is a single word, written by a single
+// store, and a flag tells the zero cross ISR to look for them. No one ever spins: on the dual-core
+// chips the accesses are atomic (and ordered) by themselves, on AVR the 4 bytes of the word are
+// written with the interrupts held back for a few cycles.
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_RP2040)
+#define POST_STORE(var, value) __atomic_store_n(&(var), (value), __ATOMIC_SEQ_CST)
+#define POST_LOAD(var)         __atomic_load_n(&(var), __ATOMIC_SEQ_CST)
+#elif defined(ARDUINO_ARCH_AVR)
+#define POST_STORE(var, value) \
+  do {                         \
+    uint8_t postState = SREG;  \
+    cli();                     \
+    (var) = (value);           \
+    SREG = postState;          \
+  } while (0)
+#define POST_LOAD(var) (var)
+#else
+// Single core, aligned 32-bit accesses are atomic
+#define POST_STORE(var, value) ((var) = (value))
+#define POST_LOAD(var)         (var)
+#endif
+
+// Kinds of the posted values. The word packs the value (bits 0-15), its kind (bits 16-23) and a
+// generation (bits 24-31), so the same value posted again is told apart from the applied one.
+static const uint8_t POSTED_NONE = 0;
+static const uint8_t POSTED_DELAY = 1;
+static const uint8_t POSTED_PHASE = 2;
+
+/**
+ * Set after each post, cleared by the zero cross ISR before looking for the posted words.
+ */
+static volatile uint8_t postsPending = 0;
+#endif
+
+/**
+ * Nesting counter of the main thread updates (i.e. changing the thyristors, their order or the
+ * back schedule). While it is not null, the zero cross ISR doesn't touch them to advance the
+ * fades.
+ */
+static volatile uint8_t mainUpdating = 0;
+
+/**
+ * Number of thyristors with a fade in progress.
+ */
+static volatile uint8_t fadingThyristors = 0;
+
+static void beginMainUpdate() {
+#if defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+  // Thyristors may be instantiated before begin()
+  if (!critical_section_is_initialized(&scheduleCs)) { critical_section_init(&scheduleCs); }
+#endif
+  SCHEDULE_LOCK();
+  mainUpdating++;
+  SCHEDULE_UNLOCK();
+}
+
+static void endMainUpdate() {
+  SCHEDULE_LOCK();
+  mainUpdating--;
+  SCHEDULE_UNLOCK();
+}
 
 /**
  * Tell if zero-cross interrupt is enabled.
@@ -134,397 +640,817 @@ static bool _allThyristorsOnOff = true;
 static bool interruptEnabled = false;
 
 /**
- * Number of thyristors already managed in the current semi-period.
+ * Tell if the active schedule has all the thyristors on or off, and nothing can change it at the
+ * next zero cross (neither a new schedule nor a fade).
  */
-static uint8_t thyristorManaged = 0;
+static inline __attribute__((always_inline)) bool isSteadyOnOff() {
+#ifdef THYRISTOR_COMMAND_QUEUE
+  if (postsPending) { return false; }
+#endif
+  return activeSchedule->allThyristorsOnOff && !scheduleReady && !fadingThyristors;
+}
 
 /**
- * Number of thyristors FULLY on. The remaining ones must be turned
- * off by turn_off_gates_int at the end of the semi-period.
+ * Number of activation groups already managed in the current semi-period.
  */
-static uint8_t alwaysOnCounter = 0;
-static uint8_t alwaysOffCounter = 0;
+static uint8_t groupManaged = 0;
 
-#if defined(ARDUINO_ARCH_ESP8266)
-void HW_TIMER_IRAM_ATTR turn_off_gates_int() {
-#elif defined(ARDUINO_ARCH_ESP32)
-void ARDUINO_ISR_ATTR turn_off_gates_int() {
+#ifdef ADAPTIVE_MERGE_WINDOW
+#define ISR_CLOCK_INLINE inline __attribute__((always_inline))
+
+/**
+ * Free running clock to measure the ISRs, see Thyristor::Stats::ticksPerMicrosecond.
+ */
+static ISR_CLOCK_INLINE uint32_t isrClock() {
+#if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
+  return ESP.getCycleCount();
+#elif defined(ARDUINO_ARCH_SAMD)
+  return SysTick->VAL;
+#else
+  // No cycle counter on AVR and Cortex-M0+, and SysTick may be not running on RP2040
+  return micros();
+#endif
+}
+
+static ISR_CLOCK_INLINE uint32_t isrElapsed(uint32_t start) {
+#if defined(ARDUINO_ARCH_SAMD)
+  // SysTick counts down, and it is reloaded every millisecond
+  uint32_t now = SysTick->VAL;
+  return start >= now ? start - now : start + SysTick->LOAD + 1 - now;
+#else
+  return isrClock() - start;
+#endif
+}
+
+static uint16_t isrTicksPerMicrosecond() {
+#if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
+  return ESP.getCpuFreqMHz();
+#elif defined(ARDUINO_ARCH_SAMD)
+  return F_CPU / 1000000;
 #else
-void turn_off_gates_int() {
+  return 1;
+#endif
+}
+#endif
+
+#ifdef THYRISTOR_STATS
+#define STATS_INLINE inline __attribute__((always_inline))
+
+/**
+ * Maximum and running average (x16) of an ISR duration.
+ */
+struct IsrDuration {
+  uint32_t max;
+  uint32_t avg16;
+};
+
+/**
+ * Collected by the ISRs, without any lock: the main thread takes a snapshot in getStats().
+ */
+static struct {
+  uint32_t zeroCrosses;
+  uint32_t glitches;
+  uint32_t lateSemiPeriods;
+  uint32_t missedGroups;
+  uint32_t alarms;
+  IsrDuration zeroCrossIsr;
+  IsrDuration activationIsr;
+  uint16_t fireErrorMax;
+  int32_t fireErrorAvg16;
+} stats;
+
+/**
+ * Time point (micros()) the activations of the current semi-period are scheduled from.
+ */
+static uint32_t statsOrigin = 0;
+
+static STATS_INLINE void recordDuration(IsrDuration &duration, uint32_t elapsed) {
+  if (elapsed > duration.max) { duration.max = elapsed; }
+  duration.avg16 += elapsed - (duration.avg16 >> 4);
+}
+
+/**
+ * Measure the ISR duration from its construction to its destruction, whatever the return point.
+ */
+class IsrTimer {
+public:
+  STATS_INLINE IsrTimer(IsrDuration &duration) : duration(duration), start(isrClock()) {}
+
+  STATS_INLINE ~IsrTimer() {
+    recordDuration(duration, isrElapsed(start));
+  }
+
+private:
+  IsrDuration &duration;
+  uint32_t start;
+};
+#endif
+
+#ifdef ADAPTIVE_MERGE_WINDOW
+/**
+ * Like the maximum duration of the activation ISR (in clock ticks), but it decays at each zero
+ * cross, since it adapts the merge period: one slow ISR (e.g. a flash cache miss) widens it only
+ * for a while.
+ */
+static uint32_t activationPeak = 0;
+
+/**
+ * The peak loses 1/2^peakDecayShift of its value per semi-period: it halves in about 44 of them.
+ */
+static const uint8_t peakDecayShift = 6;
+
+/**
+ * Measure the activation ISR, as IsrTimer, for the peak and the statistics.
+ */
+class ActivationTimer {
+public:
+  ISR_CLOCK_INLINE ActivationTimer() : start(isrClock()) {}
+
+  ISR_CLOCK_INLINE ~ActivationTimer() {
+    uint32_t elapsed = isrElapsed(start);
+    if (elapsed > activationPeak) { activationPeak = elapsed; }
+#ifdef THYRISTOR_STATS
+    recordDuration(stats.activationIsr, elapsed);
 #endif
-  for (int i = alwaysOnCounter; i < Thyristor::nThyristors; i++) {
-    digitalWrite(pinDelay[i].pin, LOW);
   }
 
-#if defined(ARDUINO_ARCH_AVR)
-  timerStop();
+private:
+  uint32_t start;
+};
 #endif
+
+#ifdef THREE_PHASE_ZONES
+/**
+ * Zero cross of the zone w.r.t. the one of the sync signal, in microseconds. The lines lag by 120°
+ * and 240°, i.e. 2/3 and 4/3 (that is 1/3) of the semi-period.
+ */
+static uint16_t THYRISTOR_ISR_ATTR zoneOffset(uint8_t zone) {
+  return (uint32_t)semiPeriodLength * ((2 * zone) % 3) / 3;
+}
+#endif
+
+/**
+ * Group the gates of pinDelay[from;to) by port, storing them in *gates*.
+ * Return the number of used entries.
+ */
+static uint8_t THYRISTOR_ISR_ATTR groupGatesByPort(const PinDelay *pinDelay, uint8_t from,
+                                                   uint8_t to, GpioPortMask *gates) {
+  uint8_t count = 0;
+  for (uint8_t i = from; i < to; i++) {
+#ifdef THREE_PHASE_ZONES
+    if (pinDelay[i].turnOff) { continue; }
+#endif
+    uint8_t j = 0;
+    while (j < count && gates[j].port != pinDelay[i].gate.port) { j++; }
+    if (j == count) {
+      gates[j].port = pinDelay[i].gate.port;
+      gates[j].mask = 0;
+      count++;
+    }
+    gates[j].mask |= pinDelay[i].gate.mask;
+  }
+  return count;
+}
+
+void THYRISTOR_ISR_ATTR turn_off_gates_int() {
+  const Schedule *s = activeSchedule;
+  for (int i = 0; i < s->dimmedGatesCount; i++) {
+    gpioClear(s->dimmedGates[i].port, s->dimmedGates[i].mask);
+  }
+
+  HwTimer::halt();
 }
 
 /**
  * Timer routine to turn on one or more thyristors. This function may be be called multiple times
  * per semi-period depending on the current thyristors configuration.
  */
-#if defined(ARDUINO_ARCH_ESP8266)
-void HW_TIMER_IRAM_ATTR activate_thyristors() {
-#elif defined(ARDUINO_ARCH_ESP32)
-void ARDUINO_ISR_ATTR activate_thyristors() {
-#else
-void activate_thyristors() {
+void THYRISTOR_ISR_ATTR activate_thyristors() {
+  const Schedule *s = activeSchedule;
+  // A stale alarm, e.g. one already pending when halt() ran, finds no group left to activate
+  if (groupManaged >= s->groupCount) { return; }
+#ifdef ADAPTIVE_MERGE_WINDOW
+  ActivationTimer timer;
 #endif
+  const ActivationGroup *g = &s->groups[groupManaged];
+  groupManaged++;
 
-  const uint8_t firstToBeUpdated = thyristorManaged;
+#ifdef SHORT_PULSE_GATES
+  for (int i = g->firstPulseOff; i < g->pulseOffEnd; i++) {
+    gpioClear(s->pulseOffGates[i].port, s->pulseOffGates[i].mask);
+  }
+#endif
 
-  for (;
-       // The last thyristor is managed outside the loop
-       thyristorManaged < Thyristor::nThyristors - 1 &&
-       // Consider the "near" thyristors
-       pinDelay[thyristorManaged + 1].delay - pinDelay[firstToBeUpdated].delay < mergePeriod &&
-       // Exclude the one who must remain totally off
-       pinDelay[thyristorManaged].delay <= semiPeriodLength - endMargin;
-       thyristorManaged++) {
-    digitalWrite(pinDelay[thyristorManaged].pin, HIGH);
+  for (int i = g->firstGate; i < g->gatesEnd; i++) {
+    gpioSet(s->groupGates[i].port, s->groupGates[i].mask);
   }
-  digitalWrite(pinDelay[thyristorManaged].pin, HIGH);
-  thyristorManaged++;
 
-  // This while is dedicated to all those thyristors with delay == semiPeriodLength-margin; those
-  // are the ones who shouldn't turn on, hence they can be skipped
-  while (thyristorManaged < Thyristor::nThyristors && pinDelay[thyristorManaged].delay == semiPeriodLength) {
-    thyristorManaged++;
+#ifdef THREE_PHASE_ZONES
+  // The zones close to their own zero cross
+  for (uint8_t z = 0; g->turnOffZones >> z; z++) {
+    if (!(g->turnOffZones & (1 << z))) { continue; }
+    for (int i = 0; i < s->zoneGatesCount[z]; i++) {
+      gpioClear(s->zoneGates[z][i].port, s->zoneGates[z][i].mask);
+    }
   }
+#endif
+
+#ifdef THYRISTOR_STATS
+  int32_t error = (int32_t)(micros() - statsOrigin) - g->delay;
+  uint16_t absError = error < 0 ? -error : error;
+  if (absError > stats.fireErrorMax) { stats.fireErrorMax = absError; }
+  stats.fireErrorAvg16 += error - (stats.fireErrorAvg16 >> 4);
+#endif
 
 #ifdef PREDEFINED_PULSE_LENGTH
   delayMicroseconds(pulseWidth);
 
-  for (int i = firstToBeUpdated; i < thyristorManaged; i++) { digitalWrite(pinDelay[i].pin, LOW); }
+  for (int i = g->firstGate; i < g->gatesEnd; i++) {
+    gpioClear(s->groupGates[i].port, s->groupGates[i].mask);
+  }
 #endif
 
-  if (thyristorManaged < Thyristor::nThyristors) {
-    int delayAbsolute = pinDelay[thyristorManaged].delay;
-
-#if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_SAMD) || (defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED))
-    int delayRelative = delayAbsolute - pinDelay[firstToBeUpdated].delay;
+#if defined(THYRISTOR_STATS) && !defined(NO_TRAILING_TURN_OFF)
+  stats.alarms++;
 #endif
-
-#if defined(ARDUINO_ARCH_ESP8266)
-    timer1_write(US_TO_RTC_TIMER_TICKS(delayRelative));
-#elif defined(ARDUINO_ARCH_ESP32)
-    setAlarm(delayAbsolute);
-#elif defined(ARDUINO_ARCH_AVR)
-    timerSetAlarm(microsecond2Tick(delayRelative));
-#elif defined(ARDUINO_ARCH_SAMD)
-  timerStart(microsecond2Tick(delayRelative));
-#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
-  timerStart(delayRelative);
-#else
-  #error "Not implemented"
+  if (groupManaged < s->groupCount) {
+#if defined(THYRISTOR_STATS) && defined(NO_TRAILING_TURN_OFF)
+    stats.alarms++;
 #endif
+    HwTimer::next(g->nextAlarm);
   } else {
-
-#ifdef PREDEFINED_PULSE_LENGTH
+#ifdef NO_TRAILING_TURN_OFF
     // If there are not more thyristor to serve, I can stop timer. Energy saving?
-#if defined(ARDUINO_ARCH_ESP8266)
-    // Given the Arduino HAL and esp8266 technical reference manual,
-    // when timer triggers, the counter stops because it has reach zero
-    // and no-autorealod was set (this timer can only down-count).
-#elif defined(ARDUINO_ARCH_ESP32)
-    stopTimer();
-#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_SAMD)
-    // Given actual HAL, AVR and SAMD counter automatically stops on interrupt
-#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
-    // Timer callback is not rescheduled
-#endif
+    HwTimer::finish();
 #else
     // If there are not more thyristors to serve, set timer to turn off gates' signal
-    uint16_t delayAbsolute = semiPeriodLength - gateTurnOffTime;
-
-#if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_SAMD) || (defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED))
-    uint16_t delayRelative = delayAbsolute - pinDelay[firstToBeUpdated].delay;
-#endif
-
-#if defined(ARDUINO_ARCH_ESP8266)
-    timer1_attachInterrupt(turn_off_gates_int);
-    timer1_write(US_TO_RTC_TIMER_TICKS(delayRelative));
-#elif defined(ARDUINO_ARCH_ESP32)
-    nextISR = INT_TYPE::TURN_OFF_GATES;
-    setAlarm(delayAbsolute);
-#elif defined(ARDUINO_ARCH_AVR)
-    timerSetCallback(turn_off_gates_int);
-    timerSetAlarm(microsecond2Tick(delayRelative));
-#elif defined(ARDUINO_ARCH_SAMD)
-    timerSetCallback(turn_off_gates_int);
-    timerStart(microsecond2Tick(delayRelative));
-#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
-    timerSetCallback(turn_off_gates_int);
-    timerStart(delayRelative);
-#else
-    #error "Not implemented"
-#endif
+    HwTimer::setCallback(turn_off_gates_int);
+    HwTimer::next(g->nextAlarm);
 #endif
   }
 }
 
-#ifdef FILTER_INT_PERIOD
+#ifdef PRINT_INT_PERIOD
 // In microsecond
 const static int semiPeriodShrinkMargin = 50;
 const static int semiPeriodExpandMargin = 50;
 #endif
 
-#if defined(FILTER_INT_PERIOD) || defined(MONITOR_FREQUENCY)
-static uint32_t lastTime = 0;
+#ifdef TRACK_ZERO_CROSS
+static ZeroCrossTracker tracker;
+#ifdef AVR_INPUT_CAPTURE
+// Capture of the last accepted zero cross
+static uint16_t lastCapture = 0;
+#endif
 #endif
 
-#ifdef MONITOR_FREQUENCY
-// Circular queue to compute the moving average
-static CircularQueue<uint32_t, 5> queue;
-static uint32_t total = 0;
+#ifdef ZC_PREDICTIVE_FIRING
+// Maximum shift of the activations w.r.t. the detected zero cross, in microseconds
+static const int16_t maxPredictionShift = 100;
 #endif
 
-#if defined(ARDUINO_ARCH_ESP8266)
-void HW_TIMER_IRAM_ATTR zero_cross_int() {
-#elif defined(ARDUINO_ARCH_ESP32)
-void ARDUINO_ISR_ATTR zero_cross_int() {
-#else
-void zero_cross_int() {
+#ifdef AUTO_SEMI_PERIOD
+// Cleared by setFrequency(): the semi-period is then fixed by the user
+static bool autoFrequency = true;
+
+// Minimum difference between the estimated semi-period and the current one to adopt the
+// estimate, in microseconds. It avoids rebuilding the schedule at every zero cross.
+static const uint16_t semiPeriodTolerance = 4;
 #endif
 
-#if defined(FILTER_INT_PERIOD) || defined(MONITOR_FREQUENCY)
-  if (!lastTime) {
-    lastTime = micros();
-  } else {
-    uint32_t now = micros();
+#ifndef PERIPHERAL_GATES
+// Toggled at each zero cross, burst-fire decisions are taken at the start of a cycle only
+static bool burstNewCycle = false;
+#endif
 
-    // "diff" is correct even when timer rolls back, because these values are unsigned
-    uint32_t diff = now - lastTime;
+void THYRISTOR_ISR_ATTR zero_cross_int() {
+#ifdef THYRISTOR_ISR_CORE
+  // Never detached, see Thyristor::detachZeroCross()
+  if (!interruptEnabled) { return; }
+#endif
+#ifdef THYRISTOR_STATS
+  IsrTimer timer(stats.zeroCrossIsr);
+#endif
+
+#ifdef TRACK_ZERO_CROSS
+  uint32_t now = micros();
+
+#ifdef AVR_INPUT_CAPTURE
+  // The edge has been latched by the hardware: as long as the timer cannot have wrapped since the
+  // previous zero cross, date it from that one, unaffected by the interrupt latency
+  uint16_t capture = timerCaptureTick();
+  if (now - tracker.getLastTime() < tick2Microsecond(UINT16_MAX)) {
+    now = tracker.getLastTime() + tick2Microsecond(capture - lastCapture);
+  }
+#endif
 
 #ifdef PRINT_INT_PERIOD
-    if (diff < semiPeriodLength - semiPeriodShrinkMargin) {
+  // "diff" is correct even when timer rolls back, because these values are unsigned
+  uint32_t diff = now - tracker.getLastTime();
+  if (diff < semiPeriodLength - semiPeriodShrinkMargin) {
 #ifdef ARDUINO_ARCH_ESP32
-      ets_printf("B%d\n", diff);
+    ets_printf("B%d\n", diff);
 #else
-      Serial.println(String('B') + diff);
+    Serial.println(String('B') + diff);
 #endif
-    }
-    if (diff > semiPeriodLength + semiPeriodExpandMargin) {
+  }
+  if (diff > semiPeriodLength + semiPeriodExpandMargin) {
 #ifdef ARDUINO_ARCH_ESP32
-      ets_printf("A%d\n", diff);
+    ets_printf("A%d\n", diff);
 #else
-      Serial.println(String('A') + diff);
+    Serial.println(String('A') + diff);
 #endif
-    }
+  }
+#endif
+
+  bool accepted = tracker.update(now);
+#ifdef AVR_INPUT_CAPTURE
+  if (accepted) { lastCapture = capture; }
 #endif
 
 #ifdef FILTER_INT_PERIOD
-    // Filters out spurious interrupts. The effectiveness of this simple
-    // filter could vary depending on noise on electrical networ.
-    if (diff < semiPeriodLength - semiPeriodShrinkMargin) { return; }
+  // Filters out spurious interrupts, i.e. too early w.r.t. the predicted zero cross. The
+  // effectiveness of this filter could vary depending on noise on electrical network.
+  if (!accepted) {
+#ifdef THYRISTOR_STATS
+    stats.glitches++;
+#endif
+    return;
+  }
+#else
+  (void)accepted;
+#endif
+#endif
+
+#ifdef ADAPTIVE_MERGE_WINDOW
+  // Also for the small values, whose shifted share is 0
+  activationPeak -= (activationPeak >> peakDecayShift) + (activationPeak != 0);
+#endif
+
+#ifdef THYRISTOR_STATS
+  stats.zeroCrosses++;
+#ifdef TRACK_ZERO_CROSS
+  statsOrigin = now;
+#else
+  statsOrigin = micros();
+#endif
+#endif
+
+#if defined(THYRISTOR_COMMAND_QUEUE)
+  // Waiting for posted values: the gates are steadily on or off since the last schedule switch
+  if (isSteadyOnOff()) {
+#ifdef AUTO_SEMI_PERIOD
+    Thyristor::zeroCrossUpdate();
+#endif
+    return;
+  }
+#elif defined(MONITOR_FREQUENCY)
+  // Monitoring only: the gates are steadily on or off since the last schedule switch, so only the
+  // zero cross is tracked (and the semi-period may still follow it)
+  if (Thyristor::frequencyMonitorAlwaysEnabled && isSteadyOnOff()) {
+#ifdef AUTO_SEMI_PERIOD
+    Thyristor::zeroCrossUpdate();
+#endif
+    return;
+  }
+#endif
+
+  HwTimer::restart();
+
+#ifdef PERIPHERAL_GATES
+  // Gates are driven by the peripheral, synchronized by the same signal
+  return;
+#endif
+
+  const Schedule *s = activeSchedule;
+
+#ifdef THYRISTOR_STATS
+  if (groupManaged < s->groupCount) {
+    stats.lateSemiPeriods++;
+    stats.missedGroups += s->groupCount - groupManaged;
+  }
+#endif
+
+#ifdef CHECK_MANAGED_THYR
+  if (groupManaged != s->groupCount) {
+#ifdef ARDUINO_ARCH_ESP32
+    ets_printf("E%d\n", groupManaged);
+#else
+    Serial.print("E");
+    Serial.println(groupManaged);
+#endif
+  }
+#endif
+
+  if (scheduleReady) {
+    // Turn OFF all the thyristors, even if always ON.
+    // This is to speed up transitions between ON to OFF state:
+    // If I don't turn OFF all those thyristors, I must wait
+    // a semiperiod to turn off those one.
+    for (int i = 0; i < s->allGatesCount; i++) { gpioClear(s->allGates[i].port, s->allGates[i].mask); }
+
+    // Switch to the new schedule (unless the main thread has just taken it back)
+    SCHEDULE_LOCK_ISR();
+    if (scheduleReady) {
+      scheduleReady = false;
+      frontSchedule ^= 1;
+      activeSchedule = &schedules[frontSchedule];
+    }
+    SCHEDULE_UNLOCK_ISR();
+    s = activeSchedule;
+
+    // Turn on thyristors with 0 delay (always on)
+    for (int i = 0; i < s->alwaysOnGatesCount; i++) {
+      gpioSet(s->alwaysOnGates[i].port, s->alwaysOnGates[i].mask);
+    }
+  } else {
+    // Steady state: the always on thyristors are left on, the others should be off already
+    // (turn_off_gates_int) unless this zero cross came before the end of the semi-period
+    for (int i = 0; i < s->dimmedGatesCount; i++) {
+      gpioClear(s->dimmedGates[i].port, s->dimmedGates[i].mask);
+    }
+  }
+  groupManaged = 0;
+
+#ifndef PERIPHERAL_GATES
+  // Burst-fire thyristors: whole cycles spread Bresenham-style over their window, so both the
+  // half-cycles of a cycle conduct
+  if (s->burstCount) {
+    burstNewCycle = !burstNewCycle;
+    for (uint8_t i = 0; i < s->burstCount; i++) {
+      const BurstChannel &b = s->burst[i];
+      Thyristor *t = b.thyristor;
+      if (burstNewCycle) {
+        t->burstAccumulator += b.onCycles;
+        t->burstFiring = t->burstAccumulator >= b.window;
+        if (t->burstFiring) { t->burstAccumulator -= b.window; }
+      }
+      if (t->burstFiring) { gpioSet(b.gate.port, b.gate.mask); }
+    }
+  }
+#endif
+
+  // if all are on and off, I can disable the zero cross interrupt (unless fades must go on)
+  if (s->allThyristorsOnOff && !fadingThyristors) {
+
+#if defined(THYRISTOR_COMMAND_QUEUE)
+    // The posted values are applied by this ISR, it is never detached
+#elif defined(MONITOR_FREQUENCY)
+    if (!Thyristor::frequencyMonitorAlwaysEnabled) {
+      Thyristor::detachZeroCross();
+
+      tracker.reset();
+    }
+#elif defined(FILTER_INT_PERIOD)
+    tracker.reset();
+    Thyristor::detachZeroCross();
+#else
+    Thyristor::detachZeroCross();
+#endif
+
+    // No activations in this semi-period (the timer may have been started by restart())
+    HwTimer::halt();
+
+    // The semi-period may still follow the frequency monitor
+    Thyristor::zeroCrossUpdate();
+    return;
+  }
+
+  // This block of code is inteded to manage the case near to the next semi-period:
+  // In this case we should avoid to trigger the timer, because the effective semiperiod
+  // perceived by the esp8266 could be less than 10000microsecond. This could be due to
+  // the relative time (there is no possibily to set the timer to an absolute time)
+  // Moreover, it is impossible to disable an interrupt once it is armed, neither
+  // change the callback function.
+  // NOTE: don't know why, but the timer seem trigger even when it is not set...
+  // so a provvisory solution if to set the relative callback to NULL!
+  // NOTE 2: this improvement should be think even for multiple lamp!
+  if (s->groupCount > 0) {
+#ifdef THYRISTOR_STATS
+    stats.alarms++;
+#endif
+    HwTimer::setCallback(activate_thyristors);
+#ifdef ZC_PREDICTIVE_FIRING
+    // Fire from the predicted zero cross: a late edge anticipates the activations, an early one
+    // postpones them. The following alarms are relative to the first one (on ESP32 and RP2040
+    // the HAL applies the same shift to them).
+    int16_t shift = tracker.isLocked() ? tracker.getError() : 0;
+    if (shift > maxPredictionShift) { shift = maxPredictionShift; }
+    if (shift < -maxPredictionShift) { shift = -maxPredictionShift; }
+#ifdef THYRISTOR_STATS
+    statsOrigin -= shift;
+#endif
+    HwTimer::startShifted(s->firstDelay, shift);
+#else
+    HwTimer::start(s->firstAlarm);
+#endif
+  } else {
+    HwTimer::halt();
+  }
+
+  // The current semi-period is armed, prepare the next one
+  Thyristor::zeroCrossUpdate();
+}
+
+void Thyristor::setDelay(uint16_t newDelay, uint16_t fadeTime) {
+  beginMainUpdate();
+  // The semi-period cannot change meanwhile, even if it follows the detected frequency
+#ifdef NETWORK_FREQ_RUNTIME
+  // From the requested delay, which the clamp to an unknown semi-period would turn fully ON
+  phase = toPhase(newDelay, semiPeriodLength);
+#endif
+  if (newDelay > semiPeriodLength) { newDelay = semiPeriodLength; }
+#ifndef PERIPHERAL_GATES
+  const bool wasBurst = burstWindow != 0;
+  burstWindow = 0;
+#endif
+  moveTo(newDelay, fadeTime);
+#ifndef PERIPHERAL_GATES
+  if (wasBurst) { publishBurst(); }
+#endif
+  endMainUpdate();
+}
+
+#ifdef NETWORK_FREQ_RUNTIME
+void Thyristor::setPhase(uint16_t newPhase, uint16_t fadeTime) {
+  beginMainUpdate();
+  phase = newPhase;
+#ifndef PERIPHERAL_GATES
+  const bool wasBurst = burstWindow != 0;
+  burstWindow = 0;
+#endif
+  moveTo(fromPhase(newPhase, semiPeriodLength), fadeTime);
+#ifndef PERIPHERAL_GATES
+  if (wasBurst) { publishBurst(); }
+#endif
+  endMainUpdate();
+}
+#endif
+
+#ifndef PERIPHERAL_GATES
+void Thyristor::setBurst(uint8_t onCycles, uint8_t window) {
+  if (onCycles == 0 || window == 0) {
+    setDelay(UINT16_MAX);
+    return;
+  }
+  if (onCycles >= window) {
+    setDelay(0);
+    return;
+  }
+
+  beginMainUpdate();
+  burstOn = onCycles;
+  burstWindow = window;
+#ifdef NETWORK_FREQ_RUNTIME
+  phase = UINT16_MAX;
+#endif
+  // For the phase control the thyristor is fully off, so it is kept among the last ones
+  moveTo(semiPeriodLength, 0);
+  publishBurst();
+  endMainUpdate();
+}
 #endif
 
-#endif
+#ifdef THREE_PHASE_ZONES
+void Thyristor::setZone(uint8_t newZone) {
+  if (newZone >= ZONES) { return; }
 
-#if defined(ARDUINO_ARCH_AVR)
-    // Early timer start, only for avr. This is necessary since the instructions executed in this
-    // ISR take much time (more than 30us with only 4 dimmers). Before the end of this ISR, either
-    // the timer is stop or the alarm time is properly set.
-    timerStartAndTrigger(microsecond2Tick(15000));
+  // The order of the thyristors and whether they are all on/off don't change
+  beginMainUpdate();
+  zone = newZone;
+  if (!batchUpdate) { updateSchedule(); }
+  endMainUpdate();
+}
 #endif
 
-#if defined(FILTER_INT_PERIOD) || defined(MONITOR_FREQUENCY)
-#ifdef MONITOR_FREQUENCY
-    // if diff is very very greater than the theoretical value, the electrical signal
-    // can be considered as lost for a while and I must reset my moving average.
-    // I decided to use "16" because is a power of 2, very fast to be computed.
-    if (semiPeriodLength && diff > semiPeriodLength * 16) {
-      queue.reset();
-      total = 0;
-    } else {
-      // If filtering has passed, I can update the moving average
-      uint32_t valueToRemove = queue.insert(diff);
-      total += diff;
-      total -= valueToRemove;
-    }
+#ifndef PERIPHERAL_GATES
+void Thyristor::publishBurst() {
+  // updateDelay(..) ignores an unchanged delay, but the list of burst thyristors is changed anyway
+  if (batchUpdate) { return; }
+  allThyristorsOnOff = areThyristorsOnOff();
+  updateSchedule();
+  if (!allThyristorsOnOff && !interruptEnabled) { attachZeroCross(); }
+}
 #endif
 
-    lastTime = now;
+void Thyristor::moveTo(uint16_t newDelay, uint16_t fadeTime) {
+  // A fade in progress is either replaced or cancelled
+  if (fadeRemaining) {
+    fadeRemaining = 0;
+    fadingThyristors--;
   }
-#endif
-
-  // Turn OFF all the thyristors, even if always ON.
-  // This is to speed up transitions between ON to OFF state:
-  // If I don't turn OFF all those thyristors, I must wait
-  // a semiperiod to turn off those one.
-  for (int i = 0; i < Thyristor::nThyristors; i++) { digitalWrite(pinDelay[i].pin, LOW); }
+  if (!fadeTime || !startFade(newDelay, fadeTime)) { updateDelay(newDelay); }
+}
 
-#ifdef CHECK_MANAGED_THYR
-  if (thyristorManaged != Thyristor::nThyristors) {
-#ifdef ARDUINO_ARCH_ESP32
-    ets_printf("E%d\n", thyristorManaged);
+bool Thyristor::startFade(uint16_t newDelay, uint16_t fadeTime) {
+#ifdef PERIPHERAL_GATES
+  // The zero cross ISR cannot reload the peripheral
+  (void)newDelay;
+  (void)fadeTime;
+  return false;
 #else
-    Serial.print("E");
-    Serial.println(thyristorManaged);
-#endif
-  }
-#endif
-
-  // Update the structures and set thresholds, if needed
-  if (Thyristor::newDelayValues && !Thyristor::updatingStruct) {
-    Thyristor::newDelayValues = false;
-    alwaysOffCounter = 0;
-    alwaysOnCounter = 0;
-    for (int i = 0; i < Thyristor::nThyristors; i++) {
-      pinDelay[i].pin = Thyristor::thyristors[i]->pin;
-      // Rounding delays to avoid error and unexpected behavior due to
-      // non-ideal thyristors and not perfect sine wave
-      if (Thyristor::thyristors[i]->delay == 0) {
-        alwaysOnCounter++;
-        pinDelay[i].delay = 0;
-      } else if (Thyristor::thyristors[i]->delay < startMargin) {
-        alwaysOnCounter++;
-        pinDelay[i].delay = 0;
-      } else if (Thyristor::thyristors[i]->delay == semiPeriodLength) {
-        alwaysOffCounter++;
-        pinDelay[i].delay = semiPeriodLength;
-      } else if (Thyristor::thyristors[i]->delay > semiPeriodLength - endMargin) {
-        alwaysOffCounter++;
-        pinDelay[i].delay = semiPeriodLength;
-      } else {
-        pinDelay[i].delay = Thyristor::thyristors[i]->delay;
-      }
+  if (semiPeriodLength == 0 || nThyristors > THYRISTOR_FADE_MAX_NUMBER) { return false; }
+  uint32_t steps = (uint32_t)fadeTime * 1000 / semiPeriodLength;
+  if (steps < 2) { return false; }
+  if (steps > UINT16_MAX) { steps = UINT16_MAX; }
+
+  fadeTarget = newDelay;
+  fadePosition = (uint32_t)delay << 16;
+  // The difference may exceed 15 bits: the 16.16 step needs a 64-bit intermediate
+  fadeStep = ((int64_t)newDelay - delay) * 65536 / (int32_t)steps;
+  fadeRemaining = steps;
+  fadingThyristors++;
+
+  // The intermediate delays require the zero cross interrupt
+  allThyristorsOnOff = false;
+  if (!interruptEnabled) { attachZeroCross(); }
+  return true;
+#endif
+}
+
+bool THYRISTOR_ISR_ATTR Thyristor::advanceFades() {
+  // Thyristors added while fading: finish at once rather than compiling each step for all of them
+  const bool finish = nThyristors > THYRISTOR_FADE_MAX_NUMBER;
+  bool changed = false;
+  for (int i = 0; i < nThyristors; i++) {
+    Thyristor *t = thyristors[i];
+    if (!t->fadeRemaining) { continue; }
+
+    uint16_t newDelay;
+    t->fadeRemaining = finish ? 0 : t->fadeRemaining - 1;
+    if (t->fadeRemaining == 0) {
+      newDelay = t->fadeTarget;
+      fadingThyristors--;
+    } else {
+      t->fadePosition += (uint32_t)t->fadeStep;
+      newDelay = t->fadePosition >> 16;
+    }
+    if (newDelay != t->delay) {
+      t->delay = newDelay;
+      changed = true;
     }
-    _allThyristorsOnOff = Thyristor::allThyristorsOnOff;
   }
+  return changed;
+}
 
-  thyristorManaged = 0;
+#ifdef THYRISTOR_COMMAND_QUEUE
+void THYRISTOR_ISR_ATTR Thyristor::postDelay(uint16_t newDelay) {
+  post(newDelay, POSTED_DELAY);
+}
 
-  // if all are on and off, I can disable the zero cross interrupt
-  if (_allThyristorsOnOff) {
-    for (int i = 0; i < Thyristor::nThyristors; i++) {
-      if (pinDelay[i].delay == semiPeriodLength) {
-        digitalWrite(pinDelay[i].pin, LOW);
-      } else {
-        digitalWrite(pinDelay[i].pin, HIGH);
-      }
-      thyristorManaged++;
-    }
+#ifdef NETWORK_FREQ_RUNTIME
+void THYRISTOR_ISR_ATTR Thyristor::postPhase(uint16_t newPhase) {
+  post(newPhase, POSTED_PHASE);
+}
 
-#if defined(MONITOR_FREQUENCY)
-    if (!Thyristor::frequencyMonitorAlwaysEnabled) {
-      interruptEnabled = false;
-      detachInterrupt(digitalPinToInterrupt(Thyristor::syncPin));
+uint16_t THYRISTOR_ISR_ATTR Thyristor::peekSemiPeriod() {
+#ifdef ARDUINO_ARCH_AVR
+  // Two bytes, the zero cross ISR may update them in between
+  uint8_t state = SREG;
+  cli();
+  uint16_t semiPeriod = semiPeriodLength;
+  SREG = state;
+  return semiPeriod;
+#else
+  return POST_LOAD(semiPeriodLength);
+#endif
+}
+#endif
 
-      queue.reset();
-      total = 0;
+void THYRISTOR_ISR_ATTR Thyristor::post(uint16_t value, uint8_t kind) {
+  // Concurrent posts may pick the same generation, the last store wins anyway
+  uint8_t generation = (POST_LOAD(postedWord) >> 24) + 1;
+  POST_STORE(postedWord, (uint32_t)generation << 24 | (uint32_t)kind << 16 | value);
+  POST_STORE(postsPending, 1);
+}
 
-      lastTime = 0;
+bool THYRISTOR_ISR_ATTR Thyristor::applyPosted() {
+  // Cleared before the loads: a post stored meanwhile sets it again for the next zero cross
+  POST_STORE(postsPending, 0);
+
+  bool changed = false;
+  for (int i = 0; i < nThyristors; i++) {
+    Thyristor *t = thyristors[i];
+    uint32_t word = POST_LOAD(t->postedWord);
+    if (word == t->appliedWord) { continue; }
+    t->appliedWord = word;
+    uint16_t value = word;
+    uint8_t kind = word >> 16;
+
+    // As setDelay(..) and setPhase(..) without fade
+    uint16_t newDelay;
+#ifdef NETWORK_FREQ_RUNTIME
+    if (kind == POSTED_PHASE) {
+      t->phase = value;
+      newDelay = fromPhase(value, semiPeriodLength);
+    } else {
+      t->phase = toPhase(value, semiPeriodLength);
+      newDelay = value > semiPeriodLength ? semiPeriodLength : value;
     }
-#elif defined(FILTER_INT_MONITOR)
-    lastTime = 0;
-    interruptEnabled = false;
-    detachInterrupt(digitalPinToInterrupt(Thyristor::syncPin));
 #else
-    interruptEnabled = false;
-    detachInterrupt(digitalPinToInterrupt(Thyristor::syncPin));
+    (void)kind;
+    newDelay = value > semiPeriodLength ? semiPeriodLength : value;
 #endif
-
-    return;
+    if (t->fadeRemaining) {
+      t->fadeRemaining = 0;
+      fadingThyristors--;
+    }
+    if (t->burstWindow) {
+      t->burstWindow = 0;
+      changed = true;
+    }
+    if (newDelay != t->delay) {
+      t->delay = newDelay;
+      changed = true;
+    }
   }
+  return changed;
+}
+#endif
 
-  // Turn on thyristors with 0 delay (always on)
-  while (thyristorManaged < Thyristor::nThyristors && pinDelay[thyristorManaged].delay == 0) {
-    digitalWrite(pinDelay[thyristorManaged].pin, HIGH);
-    thyristorManaged++;
+#ifdef NETWORK_FREQ_RUNTIME
+void THYRISTOR_ISR_ATTR Thyristor::rescaleDelays(uint16_t newSemiPeriod) {
+  for (int i = 0; i < nThyristors; i++) {
+    Thyristor *t = thyristors[i];
+    if (t->fadeRemaining) {
+      // Go on from the rescaled position towards the rescaled target, in the same time
+      uint16_t position = fromPhase(toPhase(t->delay, semiPeriodLength), newSemiPeriod);
+      t->fadeTarget = fromPhase(t->phase, newSemiPeriod);
+      t->fadePosition = (uint32_t)position << 16;
+      t->fadeStep = ((int64_t)t->fadeTarget - position) * 65536 / (int32_t)t->fadeRemaining;
+      t->delay = position;
+    } else {
+      t->delay = fromPhase(t->phase, newSemiPeriod);
+    }
   }
+  semiPeriodLength = newSemiPeriod;
+}
+#endif
 
-  // This block of code is inteded to manage the case near to the next semi-period:
-  // In this case we should avoid to trigger the timer, because the effective semiperiod
-  // perceived by the esp8266 could be less than 10000microsecond. This could be due to
-  // the relative time (there is no possibily to set the timer to an absolute time)
-  // Moreover, it is impossible to disable an interrupt once it is armed, neither
-  // change the callback function.
-  // NOTE: don't know why, but the timer seem trigger even when it is not set...
-  // so a provvisory solution if to set the relative callback to NULL!
-  // NOTE 2: this improvement should be think even for multiple lamp!
-  if (thyristorManaged < Thyristor::nThyristors && pinDelay[thyristorManaged].delay < semiPeriodLength) {
-    uint16_t delayAbsolute = pinDelay[thyristorManaged].delay;
-#if defined(ARDUINO_ARCH_ESP8266)
-    timer1_attachInterrupt(activate_thyristors);
-    timer1_write(US_TO_RTC_TIMER_TICKS(delayAbsolute));
-#elif defined(ARDUINO_ARCH_ESP32)
-    // setCallback(activate_thyristors);
-    nextISR = INT_TYPE::ACTIVATE_THYRISTORS;
-    startTimerAndTrigger(delayAbsolute);
-#elif defined(ARDUINO_ARCH_AVR)
-    timerSetCallback(activate_thyristors);
-    timerSetAlarm(microsecond2Tick(delayAbsolute));
-#elif defined(ARDUINO_ARCH_SAMD)
-  timerSetCallback(activate_thyristors);
-  timerStart(microsecond2Tick(delayAbsolute));
-#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
-  timerSetCallback(activate_thyristors);
-  timerStart(pinDelay[thyristorManaged].delay);
+void THYRISTOR_ISR_ATTR Thyristor::zeroCrossUpdate() {
+#ifdef AUTO_SEMI_PERIOD
+  uint16_t newSemiPeriod = 0;
+  if (autoFrequency && tracker.isLocked()) {
+    uint16_t estimate = tracker.getPeriod();
+    uint16_t change =
+      estimate > semiPeriodLength ? estimate - semiPeriodLength : semiPeriodLength - estimate;
+    if (change >= semiPeriodTolerance) { newSemiPeriod = estimate; }
+  }
+#endif
+  bool pending = fadingThyristors;
+#ifdef THYRISTOR_COMMAND_QUEUE
+  pending = pending || postsPending;
+#endif
+#ifdef AUTO_SEMI_PERIOD
+  if (!pending && !newSemiPeriod) { return; }
 #else
-  # error "Not implemented"
+  if (!pending) { return; }
 #endif
-  } else {
 
-    // This while is dedicated to all those thyristor wih delay == semiPeriodLength-margin; those
-    // are the ones who shouldn't turn on, hence they can be skipped
-    while (thyristorManaged < Thyristor::nThyristors && pinDelay[thyristorManaged].delay == semiPeriodLength) {
-      thyristorManaged++;
+  // While the main thread is updating the thyristors, everything is postponed to the next zero
+  // cross (the fades are paused meanwhile)
+  SCHEDULE_LOCK_ISR();
+  if (!mainUpdating) {
+    bool changed = false;
+#ifdef THYRISTOR_COMMAND_QUEUE
+    // Before the fades, since the posted values cancel them, and before the rescale, which
+    // follows the phases
+    changed = postsPending && applyPosted();
+#endif
+    changed |= fadingThyristors && advanceFades();
+#ifdef AUTO_SEMI_PERIOD
+    if (newSemiPeriod && autoFrequency) {
+      rescaleDelays(newSemiPeriod);
+      changed = true;
     }
-
-#if defined(ARDUINO_ARCH_ESP8266)
-    // Given the Arduino HAL and esp8266 technical reference manual,
-    // when timer triggers, the counter stops because it has reached zero
-    // and no-autorealod was set (this timer can only down-count).
-#elif defined(ARDUINO_ARCH_ESP32)
-    stopTimer();
-#elif defined(ARDUINO_ARCH_AVR)
-    timerStop();
-#elif defined(ARDUINO_ARCH_SAMD)
-  // Given actual HAL, and SAMD counter automatically stops on interrupt
-#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
-    // Timer callback is not rescheduled
 #endif
+    if (changed) {
+      sortThyristors();
+      compileBackSchedule();
+      scheduleReady = true;
+    }
   }
+  SCHEDULE_UNLOCK_ISR();
 }
 
-#if defined(ARDUINO_ARCH_ESP8266)
-void HW_TIMER_IRAM_ATTR isr_selector() {
-#elif defined(ARDUINO_ARCH_ESP32)
-void ARDUINO_ISR_ATTR isr_selector() {
-#else
-void isr_selector() {
-#endif
-  if (nextISR == INT_TYPE::ACTIVATE_THYRISTORS) {
-    activate_thyristors();
-  } else if (nextISR == INT_TYPE::TURN_OFF_GATES) {
-    turn_off_gates_int();
-  }
-}
+void Thyristor::updateDelay(uint16_t newDelay) {
+  TRACE_INFO("setDelay, pin", pin);
+  TRACE_INFO("  new delay", newDelay);
 
-void Thyristor::setDelay(uint16_t newDelay) {
-  if (verbosity > 2) {
-    for (int i = 0; i < Thyristor::nThyristors; i++) {
-      Serial.print(String("setB: ") + "posIntoArray:" + thyristors[i]->posIntoArray
-                   + " pin:" + thyristors[i]->pin);
-      Serial.print(" ");
-      Serial.println(thyristors[i]->delay);
-    }
+  // The array is reordered only once, in commitUpdate()
+  if (batchUpdate) {
+    delay = newDelay;
+    return;
   }
 
-  if (newDelay > semiPeriodLength) { newDelay = semiPeriodLength; }
-
-  // Reorder the array to speed up the interrupt.
+  // Reorder the array to speed up the preparation of the schedule.
   // This mini-algorithm works on a different memory area w.r.t. the ISR,
   // so it is concurrent-safe
 
-  updatingStruct = true;
   // Array example, it is always ordered, higher values means lower brightness levels
   // [45,678,5000,7500,9000]
   if (newDelay > delay) {
-    if (verbosity > 2) Serial.println("\tlowering the light..");
+    TRACE_INFO("  lowering the light", TRACE_NO_VALUE);
     bool done = false;
     /////////////////////////////////////////////////////////////////
     // Let's find the new position
@@ -540,7 +1466,7 @@ void Thyristor::setDelay(uint16_t newDelay) {
     // 1) the light is already the lowest delay (i.e. turned off)
     // 2) the delay is not changed to overpass the neightbour
     if (posIntoArray + 1 == i) {
-      if (verbosity > 2) Serial.println("No need to shift..");
+      TRACE_INFO("  no need to shift", TRACE_NO_VALUE);
     } else {
       int target;
       // Means that we have reached the end, the target i the last element
@@ -559,7 +1485,7 @@ void Thyristor::setDelay(uint16_t newDelay) {
       this->posIntoArray = target;
     }
   } else if (newDelay < delay) {
-    if (verbosity > 2) Serial.println("\traising the light..");
+    TRACE_INFO("  raising the light", TRACE_NO_VALUE);
     bool done = false;
     int i = posIntoArray - 1;
     while (i >= 0 && !done) {
@@ -570,7 +1496,7 @@ void Thyristor::setDelay(uint16_t newDelay) {
       }
     }
     if (posIntoArray - 1 == i) {
-      if (verbosity > 2) Serial.println("No need to shift..");
+      TRACE_INFO("  no need to shift", TRACE_NO_VALUE);
     } else {
       int target;
       // Means that we have reached the start, the target is the first element
@@ -589,126 +1515,541 @@ void Thyristor::setDelay(uint16_t newDelay) {
       this->posIntoArray = target;
     }
   } else {
-    if (verbosity > 2)
-      Serial.println("Warning: you are setting the same delay as the previous one!");
-    updatingStruct = false;
+    TRACE_INFO("  same delay as the previous one", TRACE_NO_VALUE);
     return;
   }
 
   delay = newDelay;
   bool enableInt = mustInterruptBeReEnabled(newDelay);
-  newDelayValues = true;
-  updatingStruct = false;
+#if defined(PERIPHERAL_GATES) && !defined(MONITOR_FREQUENCY)
+  // The zero cross interrupt has nothing to do, the peripheral listens to the sync pin by itself
+  enableInt = false;
+#endif
+  updateSchedule();
+  if (enableInt) {
+    TRACE_INFO("  re-enabling interrupt", TRACE_NO_VALUE);
+    attachZeroCross();
+  }
+  TRACE_INFO("  new position", posIntoArray);
+}
+
+void Thyristor::beginUpdate() {
+  if (batchUpdate) { return; }
+
+  // The ISR keeps following the last published schedule until commitUpdate()
+  beginMainUpdate();
+  batchUpdate = true;
+}
+
+void THYRISTOR_ISR_ATTR Thyristor::sortThyristors() {
+  // Insertion sort, since the array is usually almost ordered
+  for (int i = 1; i < nThyristors; i++) {
+    Thyristor *t = thyristors[i];
+    int j = i - 1;
+    while (j >= 0 && thyristors[j]->delay > t->delay) {
+      thyristors[j + 1] = thyristors[j];
+      thyristors[j + 1]->posIntoArray = j + 1;
+      j--;
+    }
+    thyristors[j + 1] = t;
+    t->posIntoArray = j + 1;
+  }
+}
+
+void Thyristor::commitUpdate() {
+  if (!batchUpdate) { return; }
+
+  sortThyristors();
+  allThyristorsOnOff = areThyristorsOnOff();
+  bool enableInt = !interruptEnabled;
+#if defined(PERIPHERAL_GATES) && !defined(MONITOR_FREQUENCY)
+  enableInt = false;
+#endif
+  batchUpdate = false;
+  updateSchedule();
   if (enableInt) {
-    if (verbosity > 2) Serial.println("Re-enabling interrupt");
-    interruptEnabled = true;
-    attachInterrupt(digitalPinToInterrupt(syncPin), zero_cross_int, syncDir);
+    attachZeroCross();
+  }
+  endMainUpdate();
+}
+
+bool Thyristor::isIdle() {
+#ifdef PERIPHERAL_GATES
+  return allThyristorsOnOff && !fadingThyristors;
+#else
+  return isSteadyOnOff();
+#endif
+}
+
+bool Thyristor::sleepIfIdle() {
+#if defined(ARDUINO_ARCH_AVR)
+  // Idle mode keeps the timers and the external interrupts running. Interrupts are re-enabled
+  // just before sleeping: the instruction after sei is always executed, so an interrupt cannot
+  // slip in between the check and the sleep.
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  cli();
+  if (!interruptEnabled || !isIdle()) {
+    sei();
+    return false;
+  }
+  sleep_enable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  return true;
+#elif defined(ARDUINO_ARCH_SAMD) || (defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED))
+#ifdef THYRISTOR_ISR_CORE
+  // The zero cross wakes only the core serving it
+  if (get_core_num() != THYRISTOR_ISR_CORE) { return false; }
+#endif
+  // A pending interrupt wakes the core even while masked, then it is served once unmasked
+  noInterrupts();
+  bool idle = interruptEnabled && isIdle();
+  if (idle) {
+#ifdef ARDUINO_ARCH_SAMD
+    __DSB();
+    __WFI();
+#else
+    __wfi();
+#endif
+  }
+  interrupts();
+  return idle;
+#else
+  // ESP8266 and ESP32: the idle task of the SDK/RTOS already halts the CPU
+  return false;
+#endif
+}
+
+void Thyristor::updateSchedule() {
+#ifdef PERIPHERAL_GATES
+  // No schedule for the ISRs, just reload the peripheral (once started)
+  if (!gatesStarted) { return; }
+  uint16_t minDelay = gateMinDelay();
+  for (int i = 0; i < nThyristors; i++) {
+    const Thyristor *t = thyristors[i];
+    if (t->delay < minDelay) {
+      gateOn(t->gateChannel);
+    } else if (t->delay > semiPeriodLength - endMargin) {
+      gateOff(t->gateChannel);
+    } else {
+      gateSetDelay(t->gateChannel, t->delay);
+    }
+  }
+  return;
+#endif
+
+  // Take the back schedule: once scheduleReady is cleared, the ISR cannot swap it anymore
+  SCHEDULE_LOCK();
+  scheduleReady = false;
+  SCHEDULE_UNLOCK();
+
+  compileBackSchedule();
+
+  // Publish it, the ISR will pick it up at the next zero cross
+  SCHEDULE_LOCK();
+  scheduleReady = true;
+  SCHEDULE_UNLOCK();
+}
+
+void THYRISTOR_ISR_ATTR Thyristor::compileBackSchedule() {
+  Schedule *s = &schedules[frontSchedule ^ 1];
+
+#ifdef ADAPTIVE_MERGE_WINDOW
+  // The cost model, with the measured cost of the thyristors in place of the estimated one
+  uint16_t ticks = isrTicksPerMicrosecond();
+  uint32_t measuredCost = (activationPeak + ticks - 1) / ticks;
+  mergeWindow = measuredCost ? computeMergePeriod(isrEntryCost + measuredCost) : mergePeriod;
+  if (mergeWindow > maxMergePeriod) { mergeWindow = maxMergePeriod; }
+#endif
+
+  struct PinDelay pinDelay[N];
+  uint8_t alwaysOnCounter = 0;
+  uint8_t alwaysOffCounter = 0;
+  bool allOnOff = true;
+  for (int i = 0; i < nThyristors; i++) {
+    Thyristor *t = thyristors[i];
+    pinDelay[i].gate = t->gate;
+#ifdef THREE_PHASE_ZONES
+    pinDelay[i].zone = t->zone;
+    pinDelay[i].turnOff = false;
+#endif
+    if (t->delay != 0 && t->delay != semiPeriodLength) { allOnOff = false; }
+    // Rounding delays to avoid error and unexpected behavior due to
+    // non-ideal thyristors and not perfect sine wave
+    if (t->delay < startMargin) {
+      alwaysOnCounter++;
+      pinDelay[i].delay = 0;
+    } else if (t->delay > semiPeriodLength - endMargin) {
+      alwaysOffCounter++;
+      pinDelay[i].delay = semiPeriodLength;
+    } else {
+      pinDelay[i].delay = t->delay;
+    }
+#ifdef THYRISTOR_STATS
+    pinDelay[i].index = i;
+    pinDelay[i].requested = pinDelay[i].delay;
+    t->delayError = 0;
+#endif
+  }
+
+  const uint8_t dimmedEnd = nThyristors - alwaysOffCounter;
+#ifdef THREE_PHASE_ZONES
+  // In the time frame of the sync signal, the activations of the lagging zones are shifted (and
+  // wrapped around the semi-period), and each zone turns off its gates just before its own zero
+  // cross: all these events are sorted again
+  PinDelay events[maxGroups];
+  uint8_t eventCount = 0;
+  uint8_t dimmedZones = 0;
+  for (uint8_t i = alwaysOnCounter; i < dimmedEnd; i++) {
+    events[eventCount] = pinDelay[i];
+    events[eventCount].delay = (pinDelay[i].delay + zoneOffset(pinDelay[i].zone)) % semiPeriodLength;
+#ifdef THYRISTOR_STATS
+    events[eventCount].requested = events[eventCount].delay;
+#endif
+    eventCount++;
+    dimmedZones |= 1 << pinDelay[i].zone;
+  }
+#ifndef PREDEFINED_PULSE_LENGTH
+  for (uint8_t z = 0; z < ZONES; z++) {
+    if (!(dimmedZones & (1 << z))) { continue; }
+    PinDelay &e = events[eventCount];
+    eventCount++;
+    e.gate.mask = 0;
+    e.delay = (zoneOffset(z) + semiPeriodLength - gateTurnOffTime) % semiPeriodLength;
+    e.zone = z;
+    e.turnOff = true;
+  }
+#endif
+  for (uint8_t i = 0; i < eventCount; i++) {
+    // The timer is re-armed at the zero cross, keep the events far from it
+    if (events[i].delay < mergeWindow) { events[i].delay = mergeWindow; }
+    if (events[i].delay > semiPeriodLength - mergeWindow) {
+      events[i].delay = semiPeriodLength - mergeWindow;
+    }
+
+    PinDelay e = events[i];
+    uint8_t j = i;
+    for (; j > 0 && events[j - 1].delay > e.delay; j--) { events[j] = events[j - 1]; }
+    events[j] = e;
+  }
+  PinDelay *chain = events;
+  const uint8_t chainBegin = 0;
+  const uint8_t chainEnd = eventCount;
+#else
+  PinDelay *chain = pinDelay;
+  const uint8_t chainBegin = alwaysOnCounter;
+  const uint8_t chainEnd = dimmedEnd;
+#endif
+
+  // Near delays are either merged into the previous group, or nudged to be at least mergeWindow
+  // away from it, whichever changes them less, so each group is activated by a single ISR
+#ifdef THREE_PHASE_ZONES
+  const uint16_t nudgeLimit = semiPeriodLength - mergeWindow;
+#else
+  const uint16_t nudgeLimit = semiPeriodLength - endMargin;
+#endif
+  uint8_t first = chainBegin;
+  for (uint8_t i = first + 1; i < chainEnd; i++) {
+    int16_t gap = chain[i].delay - chain[first].delay;
+    uint16_t nudged = chain[first].delay + mergeWindow;
+    if (gap >= (int16_t)mergeWindow) {
+      first = i;
+    } else if (2 * gap <= (int16_t)mergeWindow || nudged > nudgeLimit) {
+      chain[i].delay = chain[first].delay;
+    } else {
+      chain[i].delay = nudged;
+      first = i;
+    }
+  }
+#ifdef THYRISTOR_STATS
+  for (uint8_t i = chainBegin; i < chainEnd; i++) {
+#ifdef THREE_PHASE_ZONES
+    if (chain[i].turnOff) { continue; }
+#endif
+    thyristors[chain[i].index]->delayError = chain[i].delay - chain[i].requested;
+  }
+#endif
+
+  // Compile the activation groups, each one knowing how to arm the timer for the next event
+  s->groupCount = 0;
+  uint8_t gates = 0;
+#ifdef SHORT_PULSE_GATES
+  // The pulses still going on are chain[pulseBegin;i)
+  uint8_t pulseBegin = chainBegin;
+  uint8_t pulseOffGates = 0;
+  const uint16_t pulseEndDelay = pulseWidth > mergeWindow ? pulseWidth : mergeWindow;
+#endif
+  for (uint8_t i = chainBegin; i < chainEnd;) {
+    uint8_t groupEnd = i + 1;
+    while (groupEnd < chainEnd && chain[groupEnd].delay == chain[i].delay) { groupEnd++; }
+
+    ActivationGroup &g = s->groups[s->groupCount];
+    s->groupCount++;
+    g.firstGate = gates;
+    gates += groupGatesByPort(chain, i, groupEnd, &s->groupGates[gates]);
+    g.gatesEnd = gates;
+#ifdef SHORT_PULSE_GATES
+    uint8_t pulseEnd = pulseBegin;
+    while (pulseEnd < i && chain[pulseEnd].delay + pulseWidth <= chain[i].delay) { pulseEnd++; }
+    g.firstPulseOff = pulseOffGates;
+    pulseOffGates += groupGatesByPort(chain, pulseBegin, pulseEnd, &s->pulseOffGates[pulseOffGates]);
+    g.pulseOffEnd = pulseOffGates;
+    pulseBegin = pulseEnd;
+#endif
+#ifdef THREE_PHASE_ZONES
+    g.turnOffZones = 0;
+    for (uint8_t j = i; j < groupEnd; j++) {
+      if (chain[j].turnOff) { g.turnOffZones |= 1 << chain[j].zone; }
+    }
+#endif
+#ifdef THYRISTOR_STATS
+    g.delay = chain[i].delay;
+#endif
+    if (groupEnd < chainEnd) {
+      g.nextAlarm = HwTimer::toAlarm(chain[i].delay, chain[groupEnd].delay);
+    } else {
+#if defined(SHORT_PULSE_GATES)
+      g.nextAlarm = HwTimer::toAlarm(chain[i].delay, chain[i].delay + pulseEndDelay);
+#elif defined(NO_TRAILING_TURN_OFF)
+      g.nextAlarm = 0;
+#else
+      g.nextAlarm = HwTimer::toAlarm(chain[i].delay, semiPeriodLength - gateTurnOffTime);
+#endif
+    }
+
+    i = groupEnd;
+  }
+#ifdef SHORT_PULSE_GATES
+  // The last group turns off the remaining pulses only
+  if (s->groupCount > 0) {
+    ActivationGroup &g = s->groups[s->groupCount];
+    s->groupCount++;
+    g.firstGate = gates;
+    g.gatesEnd = gates;
+    g.firstPulseOff = pulseOffGates;
+    pulseOffGates +=
+      groupGatesByPort(chain, pulseBegin, chainEnd, &s->pulseOffGates[pulseOffGates]);
+    g.pulseOffEnd = pulseOffGates;
+#ifdef THYRISTOR_STATS
+    g.delay = chain[chainEnd - 1].delay + pulseEndDelay;
+#endif
+    g.nextAlarm = 0;
+  }
+#endif
+  if (s->groupCount > 0) {
+    s->firstAlarm = HwTimer::toAlarm(0, chain[chainBegin].delay);
+#ifdef ZC_PREDICTIVE_FIRING
+    s->firstDelay = chain[chainBegin].delay;
+#endif
+  }
+
+#ifndef PERIPHERAL_GATES
+  s->burstCount = 0;
+  for (int i = 0; i < nThyristors; i++) {
+    Thyristor *t = thyristors[i];
+    if (!t->burstWindow) { continue; }
+    BurstChannel &b = s->burst[s->burstCount];
+    s->burstCount++;
+    b.gate = t->gate;
+    b.thyristor = t;
+    b.onCycles = t->burstOn;
+    b.window = t->burstWindow;
+    allOnOff = false;
   }
+#endif
 
-  if (verbosity > 2) {
-    for (int i = 0; i < Thyristor::nThyristors; i++) {
-      Serial.print(String("\tsetB: ") + "posIntoArray:" + thyristors[i]->posIntoArray
-                   + " pin:" + thyristors[i]->pin);
-      Serial.print(" ");
-      Serial.println(thyristors[i]->delay);
+#ifdef AUTO_SEMI_PERIOD
+  // The zero cross interrupt must go on until the semi-period is detected
+  if (semiPeriodLength == 0) { allOnOff = false; }
+#endif
+  s->allThyristorsOnOff = allOnOff;
+  s->allGatesCount = groupGatesByPort(pinDelay, 0, nThyristors, s->allGates);
+  s->alwaysOnGatesCount = groupGatesByPort(pinDelay, 0, alwaysOnCounter, s->alwaysOnGates);
+#ifdef THREE_PHASE_ZONES
+  // The dimmed gates of each zone are turned off by its own event, so the ones of the lagging zones
+  // are left alone at the zero cross of the sync signal
+  PinDelay selected[N];
+  for (uint8_t z = 0; z < ZONES; z++) {
+    uint8_t count = 0;
+    for (uint8_t i = alwaysOnCounter; i < dimmedEnd; i++) {
+      if (pinDelay[i].zone == z) { selected[count++] = pinDelay[i]; }
     }
+    s->zoneGatesCount[z] = groupGatesByPort(selected, 0, count, s->zoneGates[z]);
+  }
+  uint8_t count = 0;
+  for (uint8_t i = alwaysOnCounter; i < nThyristors; i++) {
+    if (i >= dimmedEnd || pinDelay[i].zone == 0) { selected[count++] = pinDelay[i]; }
   }
+  s->dimmedGatesCount = groupGatesByPort(selected, 0, count, s->dimmedGates);
+#else
+  s->dimmedGatesCount = groupGatesByPort(pinDelay, alwaysOnCounter, nThyristors, s->dimmedGates);
+#endif
 }
 
 void Thyristor::turnOn() {
-  setDelay(semiPeriodLength);
+  // Clamped to the semi-period
+  setDelay(UINT16_MAX);
 }
 
-void Thyristor::begin() {
+bool Thyristor::begin() {
+#if defined(THYRISTOR_ISR_CORE) && !defined(ARDUINO_ARCH_ESP32)
+  // The interrupts would be served by this core, and the alarms by a pool it doesn't own
+  if (get_core_num() != THYRISTOR_ISR_CORE) {
+    if (THYRISTOR_LOG_LEVEL > 0) {
+      Serial.println(F("Thyristor::begin() must be called by THYRISTOR_ISR_CORE"));
+    }
+    return false;
+  }
+#endif
   pinMode(syncPin, syncPullup ? INPUT_PULLUP : INPUT);
 
-#if defined(ARDUINO_ARCH_ESP8266)
-  timer1_attachInterrupt(activate_thyristors);
-  // These 2 registers assignments are the "unrolling" of:
-  // timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
-  T1C = (1 << TCTE) | ((TIM_DIV16 & 3) << TCPD) | ((TIM_EDGE & 1) << TCIT) | ((TIM_SINGLE & 1) << TCAR);
-  T1I = 0;
-#elif defined(ARDUINO_ARCH_ESP32)
-  timerInit(isr_selector);
-#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_SAMD) || (defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED))
-  timerSetCallback(activate_thyristors);
-  timerBegin();
-#else
-  #error "Not implemented"
+  beginMainUpdate();
+  updateSchedule();
+  endMainUpdate();
+
+#ifdef ESP32_MCPWM_GATES
+  mcpwmPeriod = mcpwmGatesBegin(syncPin, N, gateOffTime());
+#endif
+#if defined(THYRISTOR_ISR_CORE) && defined(ARDUINO_ARCH_ESP32)
+  if (xPortGetCoreID() == THYRISTOR_ISR_CORE) {
+    installInterrupts();
+  } else {
+    SemaphoreHandle_t installed = xSemaphoreCreateBinary();
+    xTaskCreatePinnedToCore(installInterruptsTask, "thyristor", 2048, &installed,
+                            configMAX_PRIORITIES - 1, nullptr, THYRISTOR_ISR_CORE);
+    xSemaphoreTake(installed, portMAX_DELAY);
+    vSemaphoreDelete(installed);
+  }
+#elif defined(THYRISTOR_ISR_CORE)
+  installInterrupts();
+#elif !defined(PERIPHERAL_GATES)
+  HwTimer::begin(activate_thyristors);
+#endif
+#ifdef AVR_INPUT_CAPTURE
+  timerCaptureBegin(zero_cross_int, syncDir);
 #endif
 
-#ifdef MONITOR_FREQUENCY
+#ifdef PERIPHERAL_GATES
+#ifdef RP2040_PIO_GATES
+  pioGatesBegin(syncPin);
+#endif
+  for (int i = 0; i < nThyristors; i++) {
+    if (!gateAttach(thyristors[i]->gateChannel, thyristors[i]->pin) && THYRISTOR_LOG_LEVEL > 0) {
+      Serial.print(F("Cannot drive the gate of pin "));
+      Serial.println(thyristors[i]->pin);
+    }
+  }
+  gatesStarted = true;
+  updateSchedule();
+#endif
+
+#if defined(MONITOR_FREQUENCY)
   // Starts immediately to sense the eletricity grid
 
-  interruptEnabled = true;
-  attachInterrupt(digitalPinToInterrupt(syncPin), zero_cross_int, syncDir);
+  attachZeroCross();
+#elif defined(THYRISTOR_COMMAND_QUEUE)
+  // The posted values are applied by the zero cross ISR
+  if (!interruptEnabled) { attachZeroCross(); }
 #endif
+  return true;
 }
 
 float Thyristor::getFrequency() {
-  if (semiPeriodLength == 0) { return 0; }
-  return 1000000 / 2 / (float)(semiPeriodLength);
+  uint16_t semiPeriod = getSemiPeriod();
+  if (semiPeriod == 0) { return 0; }
+  return 1000000 / 2 / (float)(semiPeriod);
 }
 
 uint16_t Thyristor::getSemiPeriod() {
+#ifdef AUTO_SEMI_PERIOD
+  // It may be updated by the zero cross ISR
+  SCHEDULE_LOCK();
+  uint16_t semiPeriod = semiPeriodLength;
+  SCHEDULE_UNLOCK();
+  return semiPeriod;
+#else
   return semiPeriodLength;
+#endif
 }
 
 #ifdef NETWORK_FREQ_RUNTIME
 void Thyristor::setFrequency(float frequency) {
   if (frequency < 0) { return; }
 
-  if (frequency == 0) {
-    semiPeriodLength = 0;
-    return;
-  }
+  beginMainUpdate();
+#ifdef AUTO_SEMI_PERIOD
+  // From now on the semi-period is fixed, unless it is reset to 0
+  autoFrequency = frequency == 0;
+#endif
+  // The delays keep their phase, no need to set them again
+  rescaleDelays(frequency == 0 ? 0 : 1000000 / 2 / frequency);
+
+#ifdef ESP32_MCPWM_GATES
+  if (gatesStarted) { mcpwmPeriod = mcpwmGatesSetPeriod(N, gateOffTime()); }
+#endif
 
-  semiPeriodLength = 1000000 / 2 / frequency;
+  // Otherwise everything is applied by commitUpdate()
+  if (!batchUpdate) {
+    sortThyristors();
+    allThyristorsOnOff = areThyristorsOnOff();
+    bool enableInt = !allThyristorsOnOff && !interruptEnabled;
+#if defined(PERIPHERAL_GATES) && !defined(MONITOR_FREQUENCY)
+    enableInt = false;
+#endif
+    updateSchedule();
+    if (enableInt) { attachZeroCross(); }
+  }
+  endMainUpdate();
 }
 #endif
 
 #ifdef MONITOR_FREQUENCY
 float Thyristor::getDetectedFrequency() {
-  int c;
-  uint32_t tot;
+  uint32_t period;
   {
     // Stop interrupt to freeze variables modified or accessed in the interrupt
     noInterrupts();
 
     // "diff" is correct even when rolling back, because all of them are unsigned
-    uint32_t diff = micros() - lastTime;
-
-    // if diff is very very greater than the theoretical value, the electrical signal
-    // can be considered as lost for a while.
-    // I decided to use "16" because is a power of 2, very fast to be computed.
-    if (semiPeriodLength && diff > semiPeriodLength * 16) {
-      queue.reset();
-      total = 0;
+    uint32_t diff = micros() - tracker.getLastTime();
+
+    // if diff is very very greater than the estimated value, the electrical signal
+    // can be considered as lost for a while. Since the estimate is in 1/16 of microsecond, it
+    // equals 16 times the semi-period in microseconds.
+    period = tracker.isLocked() ? tracker.getPeriod16() : 0;
+    if (period && diff > period) {
+      tracker.reset();
+      period = 0;
     }
 
-    c = queue.getCount();
-    tot = total;
     interrupts();
   }
 
-  // We need at least a sample to return a value differnt from 0
-  if (tot > 0) {
+  // The estimate is meaningful only once the tracker is locked
+  if (period > 0) {
     // *1000000: us
+    // *16: the period is in 1/16 of microsecond
     // /2: from semiperiod to full period
-    float result = c * 1000000 / 2 / ((float)(tot));
-    return result;
+    return 1000000.0f * 16 / 2 / period;
   }
   return 0;
 }
 
+uint16_t Thyristor::getZeroCrossJitter() {
+  noInterrupts();
+  uint16_t jitter = tracker.getJitter();
+  interrupts();
+  return jitter;
+}
+
 void Thyristor::frequencyMonitorAlwaysOn(bool enable) {
   {
     // Stop interrupt to freeze variables modified or accessed in the interrupt
     noInterrupts();
 
     if (enable && !interruptEnabled) {
-      interruptEnabled = true;
-      attachInterrupt(digitalPinToInterrupt(syncPin), zero_cross_int, syncDir);
+      attachZeroCross();
     }
     frequencyMonitorAlwaysEnabled = enable;
 
@@ -717,11 +2058,90 @@ void Thyristor::frequencyMonitorAlwaysOn(bool enable) {
 }
 #endif
 
-Thyristor::Thyristor(int pin) : pin(pin), delay(semiPeriodLength) {
+#ifdef THYRISTOR_STATS
+Thyristor::Stats Thyristor::getStats() {
+  Stats snapshot;
+
+  noInterrupts();
+  snapshot.zeroCrosses = stats.zeroCrosses;
+  snapshot.glitches = stats.glitches;
+  snapshot.lateSemiPeriods = stats.lateSemiPeriods;
+  snapshot.missedGroups = stats.missedGroups;
+  snapshot.alarms = stats.alarms;
+  snapshot.zeroCrossIsrMax = stats.zeroCrossIsr.max;
+  snapshot.zeroCrossIsrAvg = stats.zeroCrossIsr.avg16 >> 4;
+  snapshot.activationIsrMax = stats.activationIsr.max;
+  snapshot.activationIsrAvg = stats.activationIsr.avg16 >> 4;
+  snapshot.fireErrorMax = stats.fireErrorMax;
+  snapshot.fireErrorAvg = stats.fireErrorAvg16 / 16;
+  snapshot.mergePeriod = mergeWindow;
+  interrupts();
+
+  snapshot.ticksPerMicrosecond = isrTicksPerMicrosecond();
+  return snapshot;
+}
+
+void Thyristor::resetStats() {
+  noInterrupts();
+  memset(&stats, 0, sizeof(stats));
+  interrupts();
+}
+#endif
+
+#if THYRISTOR_LOG_LEVEL > 1
+void Thyristor::printTrace(Print &out) {
+  if (traceLost) {
+    out.print(F("trace: lost "));
+    out.println(traceLost);
+    traceLost = 0;
+  }
+  for (; traceCount; traceCount--) {
+    const TraceEntry &e = traceBuffer[traceHead];
+    out.print(e.message);
+    if (e.value != TRACE_NO_VALUE) {
+      out.print(F(": "));
+      out.print(e.value);
+    }
+    out.println();
+    traceHead = (traceHead + 1) % THYRISTOR_TRACE_SIZE;
+  }
+}
+#endif
+
+Thyristor::Thyristor(int pin)
+  :
+#ifdef THYRISTOR_COMMAND_QUEUE
+    postedWord(0), appliedWord(0),
+#endif
+    fadePosition(0), fadeStep(0), fadeTarget(0), fadeRemaining(0), delay(semiPeriodLength),
+#ifdef NETWORK_FREQ_RUNTIME
+    phase(UINT16_MAX),
+#endif
+#ifdef THYRISTOR_STATS
+    delayError(0),
+#endif
+#ifndef PERIPHERAL_GATES
+    burstAccumulator(0), burstFiring(false), burstOn(0), burstWindow(0),
+#endif
+    pin(pin) {
+#ifdef THREE_PHASE_ZONES
+  zone = 0;
+#endif
   if (nThyristors < N) {
+    beginMainUpdate();
     pinMode(pin, OUTPUT);
-
-    updatingStruct = true;
+    gate.port = gpioPort(pin);
+    gate.mask = gpioMask(pin);
+#ifdef PERIPHERAL_GATES
+    // Take the first free channel, it is kept for the whole life of this thyristor
+    gateChannel = 0;
+    while (usedGateChannels & (1 << gateChannel)) { gateChannel++; }
+    usedGateChannels |= 1 << gateChannel;
+    if (gatesStarted && !gateAttach(gateChannel, pin) && THYRISTOR_LOG_LEVEL > 0) {
+      Serial.print(F("Cannot drive the gate of pin "));
+      Serial.println(pin);
+    }
+#endif
 
     posIntoArray = nThyristors;
     nThyristors++;
@@ -740,27 +2160,95 @@ Thyristor::Thyristor(int pin) : pin(pin), delay(semiPeriodLength) {
     // Set the posIntoArray with a "brutal" assignement to each Thyristor
     for (int i = 0; i < nThyristors; i++) { thyristors[i]->posIntoArray = i; }
 
-    newDelayValues = true;
-    updatingStruct = false;
+    if (!batchUpdate) { updateSchedule(); }
+    endMainUpdate();
   } else {
     // TODO return error or exception
   }
 }
 
 Thyristor::~Thyristor() {
+  beginMainUpdate();
+  if (fadeRemaining) { fadingThyristors--; }
+
   // Recompact the array
-  updatingStruct = true;
+  for (int i = posIntoArray; i < nThyristors - 1; i++) {
+    thyristors[i] = thyristors[i + 1];
+    thyristors[i]->posIntoArray = i;
+  }
   nThyristors--;
-  // TODO remove light from the static pinDelay array, and shrink the array
-  updatingStruct = false;
+  thyristors[nThyristors] = nullptr;
+
+#ifdef PERIPHERAL_GATES
+  if (gatesStarted) { gateDetach(gateChannel); }
+  usedGateChannels &= ~(1 << gateChannel);
+  if (!batchUpdate) { updateSchedule(); }
+#else
+  if (!batchUpdate) {
+    updateSchedule();
+  } else if (burstWindow) {
+    // The ISR must not refer to this thyristor anymore, so the batch is applied by now
+    sortThyristors();
+    updateSchedule();
+  }
+#endif
+  endMainUpdate();
+}
+
+void Thyristor::attachZeroCross() {
+  interruptEnabled = true;
+#if defined(THYRISTOR_ISR_CORE)
+  // Attached once by installInterrupts(): attaching it here would move it to the calling core
+#elif defined(AVR_INPUT_CAPTURE)
+  timerCaptureEnable();
+#else
+  attachInterrupt(digitalPinToInterrupt(syncPin), zero_cross_int, syncDir);
+#endif
 }
 
+void Thyristor::detachZeroCross() {
+  interruptEnabled = false;
+#if defined(THYRISTOR_ISR_CORE)
+  // The ISR just returns while disabled
+#elif defined(AVR_INPUT_CAPTURE)
+  timerCaptureDisable();
+#else
+  detachInterrupt(digitalPinToInterrupt(syncPin));
+#endif
+}
+
+#ifdef THYRISTOR_ISR_CORE
+#ifndef ARDUINO_ARCH_ESP32
+static_assert(THYRISTOR_ISR_CORE < NUM_CORES, "THYRISTOR_ISR_CORE must be a valid core");
+#else
+static_assert(THYRISTOR_ISR_CORE < portNUM_PROCESSORS, "THYRISTOR_ISR_CORE must be a valid core");
+
+void Thyristor::installInterruptsTask(void *installed) {
+  // The ESP32 interrupts are served by the core that allocates them
+  installInterrupts();
+  xSemaphoreGive(*(SemaphoreHandle_t *)installed);
+  vTaskDelete(nullptr);
+}
+#endif
+
+void Thyristor::installInterrupts() {
+#ifndef PERIPHERAL_GATES
+  HwTimer::begin(activate_thyristors, true);
+#endif
+  attachInterrupt(digitalPinToInterrupt(syncPin), zero_cross_int, syncDir);
+}
+#endif
+
 bool Thyristor::areThyristorsOnOff() {
   bool allOnOff = true;
   int i = 0;
   while (i < nThyristors && allOnOff) {
     if (thyristors[i]->getDelay() != 0 && thyristors[i]->getDelay() != semiPeriodLength) {
       allOnOff = false;
+#ifndef PERIPHERAL_GATES
+    } else if (thyristors[i]->burstWindow) {
+      allOnOff = false;
+#endif
     } else {
       i++;
     }
@@ -782,14 +2270,13 @@ bool Thyristor::mustInterruptBeReEnabled(uint16_t newDelay) {
   }
 
   allThyristorsOnOff = newAllThyristorsOnOff;
-  if (verbosity > 1) Serial.println(String("allThyristorsOnOff: ") + allThyristorsOnOff);
+  TRACE_DEBUG("allThyristorsOnOff", allThyristorsOnOff);
   return !interruptEnabled && interruptMustBeEnabled;
 }
 
 uint8_t Thyristor::nThyristors = 0;
 Thyristor* Thyristor::thyristors[Thyristor::N] = { nullptr };
-bool Thyristor::newDelayValues = false;
-bool Thyristor::updatingStruct = false;
+bool Thyristor::batchUpdate = false;
 bool Thyristor::allThyristorsOnOff = true;
 uint8_t Thyristor::syncPin = 255;
 decltype(RISING) Thyristor::syncDir = RISING;
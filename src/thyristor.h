@@ -20,6 +20,7 @@
 #ifndef THYRISTOR_H
 #define THYRISTOR_H
 
+#include "fast_gpio.h"
 #include <Arduino.h>
 
 /**
@@ -44,6 +45,103 @@
 // If enabled, you can monitor the actual frequency of the electrical network.
 //#define MONITOR_FREQUENCY
 
+// If enabled, the ISRs keep some statistics about their timing, without printing anything (see
+// Thyristor::getStats()). It adds a few instructions to each ISR. On AVR, it is also required to
+// adapt the merge period to the measured duration of the activation ISR (elsewhere it is always
+// measured).
+//#define THYRISTOR_STATS
+
+// Maximum number of thyristors that can be instantiated. It sizes the internal arrays, so it
+// affects the RAM usage, and it raises the worst-case cost of the ISRs: look at the ISR cost model
+// in thyristor.cpp before raising it.
+#ifndef THYRISTOR_MAX_NUMBER
+#define THYRISTOR_MAX_NUMBER 8
+#endif
+
+// Maximum number of thyristors for which the fades are available. Each fade step is applied by the
+// zero cross ISR, which sorts the thyristors and compiles the whole schedule again: this bounds
+// its cost. With more thyristors instantiated, the delays are applied at once, and the fades in
+// progress jump to their target.
+#ifndef THYRISTOR_FADE_MAX_NUMBER
+#if defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_ESP8266)
+#define THYRISTOR_FADE_MAX_NUMBER 16
+#else
+#define THYRISTOR_FADE_MAX_NUMBER 32
+#endif
+#endif
+
+// Messages printed by the library: 0) none, 1) errors (default), 2) debug, 3) info. The messages
+// above the level are not compiled at all. Debug and info messages are not printed where they
+// happen: they are stored into a ring buffer of THYRISTOR_TRACE_SIZE entries, without heap
+// allocations, and printed later by Thyristor::printTrace().
+#ifndef THYRISTOR_LOG_LEVEL
+#define THYRISTOR_LOG_LEVEL 1
+#endif
+
+// ESP32 only (and only the variants with MCPWM, e.g. ESP32 and ESP32-S3). If enabled, the gate
+// signals are generated by the MCPWM peripheral, whose timers are restarted by the zero cross
+// signal, instead of timer interrupts: the firing is not affected by the interrupt latency (e.g.
+// when WiFi or BT are active). The sync pin must provide a RISING edge at each zero cross, and at
+// most 12 thyristors are supported.
+//#define ESP32_MCPWM_GATES
+
+#if defined(ESP32_MCPWM_GATES) && !defined(ARDUINO_ARCH_ESP32)
+#error "ESP32_MCPWM_GATES is available only on ESP32"
+#endif
+
+// RP2040 only (non-mbed core). If enabled, the gate signals are generated by PIO state machines,
+// one per thyristor, which wait for the zero cross signal by themselves: no CPU interrupt is
+// needed to fire the thyristors. The sync pin must provide a RISING edge at each zero cross, and
+// at most 8 thyristors are supported (fewer if other libraries use PIO as well).
+//#define RP2040_PIO_GATES
+
+#if defined(RP2040_PIO_GATES) && !(defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED))
+#error "RP2040_PIO_GATES is available only on RP2040 (non-mbed)"
+#endif
+
+// AVR only. If enabled, the zero cross signal must be wired to the input capture pin of the timer
+// (ICP1: D8 on Uno/Nano, D4 on Leonardo), setSyncPin(..) is then used only to configure the pin.
+// The hardware latches the timer at each zero cross, and all the activations are scheduled from
+// that value: the interrupt latency doesn't affect the phase anymore, and the frequency monitor
+// measures tick-accurate periods.
+//#define AVR_INPUT_CAPTURE
+
+#if defined(AVR_INPUT_CAPTURE) && !defined(ARDUINO_ARCH_AVR)
+#error "AVR_INPUT_CAPTURE is available only on AVR"
+#endif
+
+// If enabled, the thyristors can be wired on the 3 lines of a three-phase network, with a single
+// zero cross circuit on the first line (see Thyristor::setZone()): the activations of the other
+// lines are scheduled 120° and 240° later by the same timer, since the lines keep their phase
+// displacement.
+//#define THREE_PHASE_ZONES
+
+#if defined(THREE_PHASE_ZONES) && (defined(ESP32_MCPWM_GATES) || defined(RP2040_PIO_GATES))
+#error "THREE_PHASE_ZONES is not available with ESP32_MCPWM_GATES and RP2040_PIO_GATES"
+#endif
+
+// ESP32 and RP2040 only (dual core). If defined, the zero cross and timer interrupts are served by
+// this core, away from the network stack (ESP32) or USB (RP2040) running on the other one. On
+// ESP32, begin() installs them from a task pinned to that core. On RP2040, begin() must be called
+// by that core (i.e. from setup1() for core 1), and the alarms get their own alarm pool. The zero
+// cross interrupt then stays attached, and it returns immediately while not needed.
+//#define THYRISTOR_ISR_CORE 1
+
+#if defined(THYRISTOR_ISR_CORE) && !defined(ARDUINO_ARCH_ESP32) && !(defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED))
+#error "THYRISTOR_ISR_CORE is available only on ESP32 and RP2040 (non-mbed)"
+#endif
+
+// If enabled, the delays can be posted from any task or ISR (see Thyristor::postDelay(..)),
+// without locking the whole application around the updates: each thyristor keeps the last posted
+// value, and the zero cross ISR applies all of them at once to the schedule of the following
+// semi-period. The zero cross interrupt then stays attached, even while all the thyristors are on
+// or off.
+//#define THYRISTOR_COMMAND_QUEUE
+
+#if defined(THYRISTOR_COMMAND_QUEUE) && (defined(ESP32_MCPWM_GATES) || defined(RP2040_PIO_GATES))
+#error "THYRISTOR_COMMAND_QUEUE is not available with ESP32_MCPWM_GATES and RP2040_PIO_GATES"
+#endif
+
 /**
  * This is the core class of this library, that provides the finest control on thyristors.
  *
@@ -70,9 +168,120 @@ public:
   void operator=(Thyristor const &t) = delete;
 
   /**
-   * Set the delay, 10000 (ms, with 50Hz voltage) to turn off the thyristor
+   * Set the delay, 10000 (ms, with 50Hz voltage) to turn off the thyristor.
+   * If *fadeTime* (in milliseconds) is not null, the delay moves linearly from the current value
+   * to the new one, one step per semi-period, advanced by the zero cross interrupt: no further
+   * call is required. Fades are paused while a batch update is open, and they are not available
+   * with ESP32_MCPWM_GATES or RP2040_PIO_GATES, nor beyond THYRISTOR_FADE_MAX_NUMBER thyristors
+   * (the new delay is applied immediately).
+   */
+  void setDelay(uint16_t delay, uint16_t fadeTime = 0);
+
+#ifdef NETWORK_FREQ_RUNTIME
+  /**
+   * Set the delay as fraction of the semi-period, in Q16 format: 0 turns on the thyristor at
+   * full power, UINT16_MAX turns it off. Unlike setDelay(..), it may be called before the
+   * frequency is known. *fadeTime* behaves as in setDelay(..).
+   *
+   * NOTE: the fraction is always kept, whatever the delay is set with: if the semi-period
+   *       changes, the delays are rescaled accordingly. While the frequency is unknown, a delay
+   *       set by setDelay(..) is kept as fully ON if 0, as fully OFF otherwise.
+   */
+  void setPhase(uint16_t phase, uint16_t fadeTime = 0);
+
+  /**
+   * Return the current delay as fraction of the semi-period (the target one while fading).
+   */
+  uint16_t getPhase() const {
+    return phase;
+  }
+#endif
+
+#ifdef THYRISTOR_COMMAND_QUEUE
+  /**
+   * Like setDelay(..) without fade, but it can be called from any task or ISR: it only stores the
+   * new delay without any lock (a single word, plus a flag), so it never waits for the other
+   * callers, the main thread nor the ISRs. The zero cross ISR applies all the posted values
+   * together once the semi-period it starts is armed, so they take effect from the second zero
+   * cross after the post (or the following one if the main thread is changing the thyristors
+   * meanwhile). A later post replaces the pending one. A fade or a burst in progress is cancelled
+   * once the value is applied.
+   *
+   * NOTE: begin() must be called before posting.
+   */
+  void postDelay(uint16_t delay);
+
+#ifdef NETWORK_FREQ_RUNTIME
+  /**
+   * Like postDelay(..), with the delay as fraction of the semi-period, see setPhase(..).
+   */
+  void postPhase(uint16_t phase);
+
+  /**
+   * Like getSemiPeriod(), but without any lock, so it can be called from any task or ISR as
+   * postDelay(..).
+   */
+  static uint16_t peekSemiPeriod();
+#endif
+#endif
+
+#if !defined(ESP32_MCPWM_GATES) && !defined(RP2040_PIO_GATES)
+  /**
+   * Switch to burst-fire (integral cycle) mode: the thyristor conducts *onCycles* whole cycles
+   * every *window* cycles, spread as evenly as possible (e.g. 1 every 3 cycles for 33/100).
+   * It is driven by the zero cross interrupt only, without timer interrupts, suitable for
+   * resistive loads like heaters. 0 and *window* cycles turn it fully off and on instead.
+   * Any later setDelay(..) goes back to phase control.
+   */
+  void setBurst(uint8_t onCycles, uint8_t window = 100);
+
+  /**
+   * Return true if the thyristor is in burst-fire mode.
+   */
+  bool isBurst() const {
+    return burstWindow != 0;
+  }
+#endif
+
+#ifdef THREE_PHASE_ZONES
+  /**
+   * Number of zones, i.e. the lines of a three-phase network.
+   */
+  static const uint8_t ZONES = 3;
+
+  /**
+   * Set the line the thyristor is wired on: 0 for the line of the sync signal (default), 1 and 2
+   * for the lines lagging 120° and 240° behind it (swap them if the phase sequence is reversed).
+   * The delay is always relative to the zero cross of the thyristor's own line. Invalid zones
+   * are ignored.
+   *
+   * NOTE: burst-fire thyristors are switched at the zero cross of the sync signal, keep them in
+   * zone 0.
    */
-  void setDelay(uint16_t delay);
+  void setZone(uint8_t zone);
+
+  uint8_t getZone() const {
+    return zone;
+  }
+#endif
+
+#ifdef THYRISTOR_STATS
+  /**
+   * Return how much the activation was moved by the last schedule, in microseconds: negative
+   * when merged into an earlier activation, positive when nudged away from it. Zero for the
+   * thyristors fully on or off.
+   */
+  int16_t getDelayError() const {
+    return delayError;
+  }
+#endif
+
+  /**
+   * Return true while a fade started by setDelay(..) is in progress.
+   */
+  bool isFading() const {
+    return fadeRemaining > 0;
+  }
 
   /**
    * Return the current delay.
@@ -96,9 +305,45 @@ public:
   ~Thyristor();
 
   /**
-   * Setup timer and interrupt routine.
+   * Setup timer and interrupt routine. Return false, without configuring anything, if called by
+   * a core other than THYRISTOR_ISR_CORE on RP2040.
+   */
+  static bool begin();
+
+  /**
+   * Start a batch update: the following setDelay(..) calls only store the new delays, without
+   * reordering the thyristors nor preparing a new schedule for the ISR. Call commitUpdate() to
+   * apply all of them. While a batch is open, the ISR keeps using the last committed delays.
    */
-  static void begin();
+  static void beginUpdate();
+
+  /**
+   * Close the batch update started by beginUpdate(): the thyristors are reordered once and the
+   * new delays are applied all together from the next zero cross.
+   */
+  static void commitUpdate();
+
+  /**
+   * Return true between beginUpdate() and commitUpdate().
+   */
+  static bool isUpdating() {
+    return batchUpdate;
+  }
+
+  /**
+   * Return true when all the thyristors are fully on or off and no fade is in progress: the ISRs
+   * leave the gates alone, at most the zero cross is tracked (see frequencyMonitorAlwaysOn(..)).
+   */
+  static bool isIdle();
+
+  /**
+   * Put the MCU into a light sleep until the next interrupt, e.g. the next zero cross, but only
+   * while isIdle() and the zero cross interrupt is enabled. Call it from loop() to save power in
+   * the steady state. The timers keep running, so millis() and micros() are not affected.
+   * Return true if the MCU has slept. On ESP8266 and ESP32 it does nothing, since their idle task
+   * already halts the CPU.
+   */
+  static bool sleepIfIdle();
 
   /**
    * Return the number of instantiated thyristors.
@@ -143,6 +388,9 @@ public:
   /**
    * Set target frequency. Negative values are ignored;
    * zero set the semi-period to 0.
+   *
+   * NOTE: if MONITOR_FREQUENCY is enabled too, the semi-period follows the detected frequency
+   * until this method fixes it; zero restores the automatic tracking.
    */
   static void setFrequency(float frequency);
 #endif
@@ -156,6 +404,12 @@ public:
    */
   static float getDetectedFrequency();
 
+  /**
+   * Get the average distance of the zero crosses from the predicted ones, in microseconds. It
+   * measures the noise of the zero cross signal.
+   */
+  static uint16_t getZeroCrossJitter();
+
   /**
    * Check if frequency monitor is always enabled.
    */
@@ -172,7 +426,80 @@ public:
   static void frequencyMonitorAlwaysOn(bool enable);
 #endif
 
-  static const uint8_t N = 8;
+#ifdef THYRISTOR_STATS
+  /**
+   * Statistics collected by the ISRs since the start or the last resetStats().
+   */
+  struct Stats {
+    /**
+     * Zero crosses handled, and the edges rejected as glitches (only with FILTER_INT_PERIOD).
+     */
+    uint32_t zeroCrosses;
+    uint32_t glitches;
+
+    /**
+     * Semi-periods ended before all the activation groups were fired, and the groups missed.
+     */
+    uint32_t lateSemiPeriods;
+    uint32_t missedGroups;
+
+    /**
+     * Timer alarms armed by the ISRs.
+     */
+    uint32_t alarms;
+
+    /**
+     * Duration of the zero cross ISR and of the timer ISR firing the thyristors, maximum and
+     * running average, in ticks of the clock (see ticksPerMicrosecond).
+     */
+    uint32_t zeroCrossIsrMax;
+    uint32_t zeroCrossIsrAvg;
+    uint32_t activationIsrMax;
+    uint32_t activationIsrAvg;
+
+    /**
+     * Distance of the activations from the scheduled time, maximum absolute value and running
+     * average, in microseconds.
+     */
+    uint16_t fireErrorMax;
+    int16_t fireErrorAvg;
+
+    /**
+     * Resolution of the ISR durations: the CPU cycles on ESP8266/ESP32, the SysTick counter on
+     * SAMD, and micros() on AVR and RP2040.
+     */
+    uint16_t ticksPerMicrosecond;
+
+    /**
+     * Merge period in use, in microseconds. It follows the slowest recent activation ISR, so it
+     * shrinks back within seconds once the slow ones are gone.
+     */
+    uint16_t mergePeriod;
+  };
+
+  /**
+   * Get a snapshot of the statistics. The ISRs are held back just for the copy.
+   */
+  static Stats getStats();
+
+  /**
+   * Clear the statistics.
+   */
+  static void resetStats();
+#endif
+
+#if THYRISTOR_LOG_LEVEL > 1
+  /**
+   * Print the debug/info messages stored since the last call, oldest first, and empty the
+   * buffer. If it overflowed, the number of lost messages is printed first.
+   */
+  static void printTrace(Print &out = Serial);
+#endif
+
+  /**
+   * Maximum number of thyristors, see THYRISTOR_MAX_NUMBER.
+   */
+  static const uint8_t N = THYRISTOR_MAX_NUMBER;
 
 private:
   /**
@@ -185,11 +512,109 @@ private:
    */
   bool mustInterruptBeReEnabled(uint16_t newDelay);
 
+  /**
+   * Either start a fade towards *newDelay*, or apply it immediately. A fade in progress is
+   * replaced.
+   */
+  void moveTo(uint16_t newDelay, uint16_t fadeTime);
+
+#if !defined(ESP32_MCPWM_GATES) && !defined(RP2040_PIO_GATES)
+  /**
+   * Publish a change of the burst-fire mode, even if the delay is unchanged.
+   */
+  void publishBurst();
+#endif
+
+  /**
+   * Apply immediately the new delay, reordering the thyristors and preparing the schedule.
+   */
+  void updateDelay(uint16_t newDelay);
+
+  /**
+   * Start a fade towards *newDelay*. Return false if it is too short to be split in more
+   * semi-periods.
+   */
+  bool startFade(uint16_t newDelay, uint16_t fadeTime);
+
+  /**
+   * Advance all the fades by one semi-period. Return true if any delay changed.
+   */
+  static bool advanceFades();
+
+#ifdef THYRISTOR_COMMAND_QUEUE
+  /**
+   * Apply the posted values, see postDelay(..). Return true if any delay changed.
+   */
+  static bool applyPosted();
+
+  /**
+   * Store a posted value, see postDelay(..).
+   */
+  void post(uint16_t value, uint8_t kind);
+#endif
+
+  /**
+   * Called by the zero cross ISR once the current semi-period is armed: advance the fades and
+   * follow the detected semi-period, preparing the schedule of the next semi-period.
+   */
+  static void zeroCrossUpdate();
+
+#ifdef NETWORK_FREQ_RUNTIME
+  /**
+   * Adopt a new semi-period, rescaling all the delays (and the fades) from their phase in a
+   * single pass. The thyristors must be sorted afterwards.
+   */
+  static void rescaleDelays(uint16_t newSemiPeriod);
+#endif
+
+  /**
+   * Order the thyristors by delay and update their posIntoArray. The array is usually (almost)
+   * ordered, so elements are moved only when the order actually changes.
+   */
+  static void sortThyristors();
+
   /**
    * Search if all the values are only on and off.
    * Return true if all are on/off, false otherwise.
    */
-  bool areThyristorsOnOff();
+  static bool areThyristorsOnOff();
+
+  /**
+   * Enable the zero cross interrupt, and set interruptEnabled accordingly.
+   */
+  static void attachZeroCross();
+
+  /**
+   * Disable the zero cross interrupt, and set interruptEnabled accordingly.
+   */
+  static void detachZeroCross();
+
+#ifdef THYRISTOR_ISR_CORE
+  /**
+   * Install the zero cross and timer interrupts on the calling core, see THYRISTOR_ISR_CORE.
+   */
+  static void installInterrupts();
+
+#ifdef ARDUINO_ARCH_ESP32
+  /**
+   * FreeRTOS task running installInterrupts() on THYRISTOR_ISR_CORE, then giving the semaphore
+   * pointed by *installed*.
+   */
+  static void installInterruptsTask(void *installed);
+#endif
+#endif
+
+  /**
+   * Prepare the schedule followed by the ISRs from the current (ordered) thyristors, and publish
+   * it. The ISR adopts it at the next zero cross.
+   */
+  static void updateSchedule();
+
+  /**
+   * Fill the back schedule from the current (ordered) thyristors, without publishing it.
+   * It may be called by the zero cross ISR too, to advance fades.
+   */
+  static void compileBackSchedule();
 
   /**
    * Number of instantiated thyristors.
@@ -202,19 +627,9 @@ private:
   static Thyristor *thyristors[];
 
   /**
-   * Variable to tell to interrupt routine to update its internal structures
+   * True between beginUpdate() and commitUpdate().
    */
-  static bool newDelayValues;
-
-  /**
-   * Variable to avoid concurrency problem between interrupt and threads.
-   * In particular, this variable is used to prevent the copy of the memory used by
-   * the array of struct during reordering (interrupt can continue because it
-   * keeps its own copy of the array).
-   * A condition variable does not make sense because interrupt routine cannot be
-   * stopped.
-   */
-  static bool updatingStruct;
+  static bool batchUpdate;
 
   /**
    * This variable tells if the thyristors are completely ON and OFF,
@@ -239,20 +654,73 @@ private:
    */
   static bool syncPullup;
 
-  /**
-   * 0) no messages
-   * 1) error messages
-   * 2) debug messages
-   * 3) info messages
-   */
-  static const uint8_t verbosity = 1;
-
   /**
    * True means the is always listeing, false means
    * auto-stop when all lights are on/off.
    */
   static bool frequencyMonitorAlwaysEnabled;
 
+  // The fields are ordered by size, so the padding is the least possible
+
+#ifdef THYRISTOR_COMMAND_QUEUE
+  /**
+   * Last value posted, see postDelay(..), with its kind and generation; and the last one applied
+   * by the zero cross ISR, which owns it.
+   */
+  volatile uint32_t postedWord;
+  uint32_t appliedWord;
+#endif
+
+  /**
+   * Fade state: the current delay and its step per semi-period (both in 16.16 fixed point), the
+   * target delay, and the number of semi-periods left. The position is unsigned, since a 16-bit
+   * delay fills all of its 32 bits.
+   */
+  uint32_t fadePosition;
+  int32_t fadeStep;
+  uint16_t fadeTarget;
+  uint16_t fadeRemaining;
+
+  /**
+   * Port and mask of the gate pin, to drive it without digitalWrite(..).
+   */
+  GpioPortMask gate;
+
+  /**
+   * Time to wait before turning on the thryristor.
+   */
+  uint16_t delay;
+
+#ifdef NETWORK_FREQ_RUNTIME
+  /**
+   * Delay as fraction of the semi-period (Q16), see setPhase(..). While fading, it refers to the
+   * target delay.
+   */
+  uint16_t phase;
+#endif
+
+#ifdef THYRISTOR_STATS
+  /**
+   * Distance of the scheduled activation from the requested one, see getDelayError().
+   */
+  int16_t delayError;
+#endif
+
+#if !defined(ESP32_MCPWM_GATES) && !defined(RP2040_PIO_GATES)
+  /**
+   * Burst-fire state, owned by the zero cross ISR: the Bresenham accumulator and whether the
+   * current cycle conducts.
+   */
+  uint16_t burstAccumulator;
+  bool burstFiring;
+
+  /**
+   * Burst-fire mode, see setBurst(..): cycles on per window, phase control if the window is 0.
+   */
+  uint8_t burstOn;
+  uint8_t burstWindow;
+#endif
+
   /**
    * Pin used to control thyristor's gate.
    */
@@ -264,10 +732,20 @@ private:
    */
   uint8_t posIntoArray;
 
+
+#ifdef THREE_PHASE_ZONES
   /**
-   * Time to wait before turning on the thryristor.
+   * Line of the three-phase network, see setZone(..).
    */
-  uint16_t delay;
+  uint8_t zone;
+#endif
+
+#if defined(ESP32_MCPWM_GATES) || defined(RP2040_PIO_GATES)
+  /**
+   * Peripheral channel generating the gate signal (MCPWM generator or PIO state machine).
+   */
+  uint8_t gateChannel;
+#endif
 
   friend void activate_thyristors();
   friend void zero_cross_int();
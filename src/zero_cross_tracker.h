@@ -0,0 +1,164 @@
+/******************************************************************************
+ *  This file is part of Dimmable Light for Arduino, a library to control     *
+ *  dimmers.                                                                  *
+ *                                                                            *
+ *  Copyright (C) 2025  Bart Celary                                           *
+ *                                                                            *
+ *  Dimmable Light for Arduino is free software; you can redistribute         *
+ *  it and/or modify it under the terms of the GNU Lesser General Public      *
+ *  License as published by the Free Software Foundation; either              *
+ *  version 2.1 of the License, or (at your option) any later version.        *
+ *                                                                            *
+ *  This library is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU          *
+ *  Lesser General Public License for more details.                           *
+ *                                                                            *
+ *  You should have received a copy of the GNU Lesser General Public License  *
+ *  along with this library; if not, see <http://www.gnu.org/licenses/>.      *
+ ******************************************************************************/
+#ifndef ZERO_CROSS_TRACKER_H
+#define ZERO_CROSS_TRACKER_H
+
+#include <stdint.h>
+
+// Updated by the zero cross ISR, see THYRISTOR_ISR_ATTR in thyristor.cpp
+#define TRACKER_INLINE inline __attribute__((always_inline))
+
+/*
+ * A minimal fixed-point tracker (alpha-beta filter, i.e. a first order PLL) of the zero cross
+ * signal. From the estimated semi-period it predicts the time of the next zero cross: edges
+ * occurring too early w.r.t. the prediction are rejected as glitches, while the others correct
+ * the phase and the period by a fraction of the prediction error.
+ * Times are in microseconds, the internal state is in 1/16 of microsecond.
+ */
+class ZeroCrossTracker {
+public:
+  ZeroCrossTracker() {
+    reset();
+  }
+
+  /**
+   * Forget everything, the next edge restarts the acquisition.
+   */
+  void reset() {
+    started = false;
+    count = 0;
+    period = 0;
+    jitter = 0;
+    error = 0;
+  }
+
+  /**
+   * Process an edge detected at time *now*. Return false if it is rejected as glitch.
+   */
+  TRACKER_INLINE bool update(uint32_t now) {
+    if (!started) {
+      started = true;
+      restart(now);
+      return true;
+    }
+
+    uint32_t diff = now - last;
+    if (count == 0) {
+      // No prediction yet, just reject what cannot be a semi-period of the electrical network
+      if (diff < minSemiPeriod) { return false; }
+      if (diff > maxSemiPeriod) {
+        restart(now);
+        return true;
+      }
+      period = diff << 4;
+      predicted = (now << 4) + period;
+      error = 0;
+      count = 1;
+      last = now;
+      return true;
+    }
+
+    int32_t e = (int32_t)((now << 4) - predicted);
+    // The tolerance adapts to the noise of the signal
+    int32_t window = (minWindow << 4) + (jitter << 2);
+    if (e < -window) { return false; }
+    if (e > window) {
+      // Either some edges have been missed, or the signal changed abruptly
+      restart(now);
+      return true;
+    }
+
+    period += e >> 4;
+    predicted += period + (e >> 2);
+    jitter += ((e < 0 ? -e : e) - (int32_t)jitter) >> 3;
+    error = e;
+    if (count < UINT8_MAX) { count++; }
+    last = now;
+    return true;
+  }
+
+  /**
+   * True if the estimate has been stable for a few semi-periods.
+   */
+  TRACKER_INLINE bool isLocked() const {
+    return count >= lockCount;
+  }
+
+  /**
+   * Return the time of the last accepted edge.
+   */
+  TRACKER_INLINE uint32_t getLastTime() const {
+    return last;
+  }
+
+  /**
+   * Return the estimated semi-period in 1/16 of microsecond, 0 if unknown.
+   */
+  TRACKER_INLINE uint32_t getPeriod16() const {
+    return count ? period : 0;
+  }
+
+  /**
+   * Return the estimated semi-period, 0 if unknown.
+   */
+  TRACKER_INLINE uint16_t getPeriod() const {
+    return (getPeriod16() + 8) >> 4;
+  }
+
+  /**
+   * Return the average distance of the edges from the predicted time.
+   */
+  uint16_t getJitter() const {
+    return (jitter + 8) >> 4;
+  }
+
+  /**
+   * Return the distance of the last accepted edge from the predicted time, positive if late.
+   */
+  TRACKER_INLINE int16_t getError() const {
+    return error / 16;
+  }
+
+private:
+  TRACKER_INLINE void restart(uint32_t now) {
+    count = 0;
+    error = 0;
+    last = now;
+  }
+
+  // Bounds of the semi-period during the acquisition (125Hz and 40Hz)
+  static const uint32_t minSemiPeriod = 4000;
+  static const uint32_t maxSemiPeriod = 12500;
+
+  // Minimum tolerance w.r.t. the predicted time
+  static const int32_t minWindow = 50;
+
+  static const uint8_t lockCount = 4;
+
+  bool started;
+  uint8_t count;
+  uint32_t last;
+  uint32_t predicted;
+  uint32_t period;
+  uint32_t jitter;
+  int32_t error;
+};
+
+#endif  // END ZERO_CROSS_TRACKER_H